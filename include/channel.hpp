@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// A bounded multi-producer, multi-consumer queue used to hand work
+// between pipeline stages. push blocks while the channel is full and pop
+// blocks while it is empty; after close, pop drains what is left and then
+// returns an empty optional.
+template <typename T> class channel {
+  std::mutex mutex_{};
+  std::condition_variable not_full_{}, not_empty_{};
+  std::deque<T> items_{};
+  std::size_t capacity_{};
+  bool closed_{false};
+
+public:
+  explicit channel(std::size_t capacity) : capacity_{capacity ? capacity : 1} {}
+
+  channel(const channel &) = delete;
+  channel &operator=(const channel &) = delete;
+
+  bool push(T v) {
+    std::unique_lock lock{mutex_};
+    not_full_.wait(lock,
+                   [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_)
+      return false;
+
+    items_.push_back(std::move(v));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool try_push(T v) {
+    std::lock_guard lock{mutex_};
+    if (closed_ || items_.size() >= capacity_)
+      return false;
+
+    items_.push_back(std::move(v));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  std::optional<T> pop() {
+    std::unique_lock lock{mutex_};
+    not_empty_.wait(lock, [this] { return closed_ || items_.size(); });
+    return take();
+  }
+
+  std::optional<T> try_pop() {
+    std::lock_guard lock{mutex_};
+    return take();
+  }
+
+  void close() {
+    std::lock_guard lock{mutex_};
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+private:
+  std::optional<T> take() {
+    if (!items_.size())
+      return std::nullopt;
+
+    std::optional<T> v{std::move(items_.front())};
+    items_.pop_front();
+    not_full_.notify_one();
+    return v;
+  }
+};
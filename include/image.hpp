@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <result.hpp>
+#include <string>
+
+namespace image {
+common::result write_ppm(const std::string &path, uint32_t width,
+                         uint32_t height, const uint8_t *rgba);
+
+common::result write_png(const std::string &path, uint32_t width,
+                         uint32_t height, const uint8_t *rgba);
+
+// Picks the encoder from the file extension, PNG unless it is .ppm
+common::result write(const std::string &path, uint32_t width, uint32_t height,
+                     const uint8_t *rgba);
+} // namespace image
@@ -8,7 +8,7 @@ namespace query {
 common::result instance_specs(specs::vk_instance *s);
 
 common::result device_specs(specs::vk_device *s, const VkInstance instance,
-                            const VkPhysicalDevice device);
+                            const VkPhysicalDevice device, bool presentation);
 
 common::result surface_specs(specs::vk_surface *s,
                              const VkPhysicalDevice device,
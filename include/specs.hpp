@@ -19,6 +19,8 @@ struct vk_device {
   std::vector<vk_queue_family> queue_families{};
   VkPhysicalDeviceProperties properties{};
   VkPhysicalDeviceFeatures features{};
+  VkPhysicalDeviceVulkan12Features features12{};
+  VkPhysicalDeviceVulkan13Features features13{};
 };
 
 struct vk_surface {
@@ -95,6 +95,14 @@ struct vma_image {
   void destroy() { vmaDestroyImage(allocator, handle, allocation); }
 };
 
+struct vma_memory {
+  vma_memory() = default;
+  vma_memory(VmaAllocator a0, VmaAllocation h) : allocator{a0}, handle{h} {}
+  VmaAllocator allocator{};
+  VmaAllocation handle{};
+  void destroy() { vmaFreeMemory(allocator, handle); }
+};
+
 struct vk_image_view {
   vk_image_view() = default;
   vk_image_view(VkDevice d, VkImageView h) : device{d}, handle{h} {}
@@ -119,6 +127,22 @@ struct vk_pipeline {
   void destroy() { vkDestroyPipeline(device, handle, nullptr); }
 };
 
+struct vk_pipeline_cache {
+  vk_pipeline_cache() = default;
+  vk_pipeline_cache(VkDevice d, VkPipelineCache h) : device{d}, handle{h} {}
+  VkDevice device{};
+  VkPipelineCache handle{};
+  void destroy() { vkDestroyPipelineCache(device, handle, nullptr); }
+};
+
+struct vk_query_pool {
+  vk_query_pool() = default;
+  vk_query_pool(VkDevice d, VkQueryPool h) : device{d}, handle{h} {}
+  VkDevice device{};
+  VkQueryPool handle{};
+  void destroy() { vkDestroyQueryPool(device, handle, nullptr); }
+};
+
 struct vk_pipeline_layout {
   vk_pipeline_layout() = default;
   vk_pipeline_layout(VkDevice d, VkPipelineLayout h) : device{d}, handle{h} {}
@@ -0,0 +1,436 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <channel.hpp>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <image.hpp>
+#include <logger.hpp>
+#include <string_view>
+#include <thread>
+
+namespace ch = std::chrono;
+namespace fs = std::filesystem;
+
+bool collect_jobs(context *c);
+bool run_batch(context *c);
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
+bool record_offscreen(context *c, uint32_t frame_index, VkBuffer vertices,
+                      draw_range range);
+bool submit_offscreen(context *c, uint32_t frame_index);
+bool read_back(context *c, uint32_t frame_index, std::vector<uint8_t> *pixels);
+void collect_queries(context *c, uint32_t frame_index);
+bool create_vertex_buffer(context *c, std::vector<vertex> *vertices,
+                          raii::resource<adapter::vma_buffer> *buffer);
+bool fill_vertex_buffer(context *c, const std::vector<vertex> &vertices,
+                        const raii::resource<adapter::vma_buffer> &buffer);
+
+namespace {
+// A job after the CPU stages: matrix read, sorted and turned into vertices
+struct loaded_job {
+  std::string output_file{};
+  std::vector<vertex> vertices{};
+  transformation matrices{};
+};
+
+struct encode_job {
+  std::string output_file{};
+  std::vector<uint8_t> pixels{};
+};
+
+// GPU-side state of one frame slot
+struct slot {
+  raii::resource<adapter::vma_buffer> vertex_buffer{};
+  VkDeviceSize capacity{};
+  std::string output_file{};
+  bool in_flight{false};
+};
+
+struct counters {
+  std::atomic<std::size_t> loaded{}, rendered{}, written{}, failed{};
+};
+
+void load_stage(context *c, std::atomic<std::size_t> *next,
+                std::atomic<std::size_t> *active, channel<loaded_job> *out,
+                counters *n);
+void encode_stage(context *c, channel<encode_job> *in, counters *n);
+bool upload(context *c, uint32_t frame_index, slot *s, loaded_job *j);
+void bind_descriptors(context *c);
+bool read_manifest(context *c, const fs::path &dir);
+bool parse_job(std::string_view line, const fs::path &dir, job *j,
+               std::string *error);
+} // namespace
+
+bool collect_jobs(context *c) {
+  logger l{c->log_level};
+  std::vector<std::string> files{};
+
+  std::error_code ec{};
+  if (fs::is_directory(c->batch, ec)) {
+    for (const auto &e : fs::directory_iterator{c->batch, ec})
+      if (e.is_regular_file())
+        files.push_back(e.path().string());
+    std::sort(files.begin(), files.end());
+  } else {
+    std::size_t begin{};
+    while (begin < c->batch.size()) {
+      auto end = c->batch.find(',', begin);
+      if (end == std::string::npos)
+        end = c->batch.size();
+      if (end > begin)
+        files.push_back(c->batch.substr(begin, end - begin));
+      begin = end + 1;
+    }
+  }
+
+  if (ec) {
+    l.loge("Failed to list batch directory: ", c->batch, "\n");
+    return false;
+  }
+
+  const fs::path dir{c->output_file.size() ? c->output_file : "."};
+  fs::create_directories(dir, ec);
+  if (ec) {
+    l.loge("Failed to create output directory: ", dir.string(), "\n");
+    return false;
+  }
+
+  for (const auto &f : files) {
+    job j{.matrix_file = f, .compress = c->compress};
+    j.output_file = (dir / fs::path{f}.stem()).string() + ".png";
+    j.red = c->red;
+    j.green = c->green;
+    j.blue = c->blue;
+    c->jobs.push_back(std::move(j));
+  }
+
+  if (c->manifest.size() && !read_manifest(c, dir)) {
+    l.loge("Failed to read manifest: ", c->manifest, "\n");
+    return false;
+  }
+
+  if (!c->jobs.size()) {
+    l.loge("The batch does not contain any matrix files\n");
+    return false;
+  }
+
+  l.logi("Collected ", c->jobs.size(), " batch jobs\n");
+  return true;
+}
+
+// Runs every job through a four stage pipeline:
+//   loader threads -> (upload, draw) on this thread -> readback -> encoders
+// The stages are connected by bounded channels, so matrix parsing, GPU work
+// and PNG encoding of different jobs overlap while memory stays bounded.
+bool run_batch(context *c) {
+  const VkDevice dev = c->device.handle;
+  logger l{c->log_level};
+
+  const auto cores = std::max(2u, std::thread::hardware_concurrency());
+  const auto loaders = std::min<std::size_t>(cores / 2, c->jobs.size());
+  const auto encoders = std::max(1u, cores / 2);
+
+  channel<loaded_job> loaded{2 * c->concurrent_frames};
+  channel<encode_job> encoded{2 * c->concurrent_frames};
+  std::atomic<std::size_t> next{0}, active{loaders};
+  counters n{};
+
+  bind_descriptors(c);
+  const auto start = ch::steady_clock::now();
+
+  std::vector<std::jthread> workers{};
+  for (std::size_t i = 0; i < loaders; ++i)
+    workers.emplace_back(load_stage, c, &next, &active, &loaded, &n);
+  for (std::size_t i = 0; i < encoders; ++i)
+    workers.emplace_back(encode_stage, c, &encoded, &n);
+
+  std::array<slot, context::concurrent_frames> slots{};
+  bool ok{true}, draining{false};
+  uint32_t frame_index{};
+
+  while (ok) {
+    const VkFence f = c->per_frame[frame_index].presentation_done.handle;
+    auto &s = slots[frame_index];
+    if (vkWaitForFences(dev, 1, &f, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+      l.loge("Failed to wait for a batch frame\n");
+      ok = false;
+      break;
+    }
+    collect_queries(c, frame_index);
+
+    if (s.in_flight) {
+      encode_job e{.output_file = std::move(s.output_file)};
+      s.in_flight = false;
+      if (!read_back(c, frame_index, &e.pixels)) {
+        ok = false;
+        break;
+      }
+
+      encoded.push(std::move(e));
+      ++n.rendered;
+    }
+
+    auto j = draining ? std::nullopt : loaded.pop();
+    if (!j) {
+      draining = true;
+      const auto busy = std::count_if(slots.begin(), slots.end(),
+                                      [](auto &e) { return e.in_flight; });
+      if (!busy)
+        break;
+    } else {
+      vkResetFences(dev, 1, &f);
+      ok = upload(c, frame_index, &s, &*j) &&
+           record_offscreen(c, frame_index, s.vertex_buffer.handle,
+                            {0, uint32_t(j->vertices.size())}) &&
+           submit_offscreen(c, frame_index);
+
+      s.output_file = std::move(j->output_file);
+      s.in_flight = ok;
+    }
+
+    frame_index = (frame_index + 1) % c->concurrent_frames;
+  }
+
+  // Slots own the vertex buffers, keep them alive until the GPU is done
+  vkDeviceWaitIdle(dev);
+  loaded.close();
+  encoded.close();
+  workers.clear();
+
+  const ch::duration<double> elapsed = ch::steady_clock::now() - start;
+  const auto seconds = elapsed.count();
+  logger s{logger::inf};
+  s.logi("Batch finished: ", n.written.load(), " of ", c->jobs.size(),
+         " files written, ", n.failed.load(), " failed\n");
+  s.logs("\tloaded: ", n.loaded.load(), ", rendered: ", n.rendered.load(),
+         ", written: ", n.written.load(), "\n");
+  s.logs("\telapsed: ", seconds, " s, throughput: ",
+         seconds > 0 ? n.written.load() / seconds : 0.0, " files/s\n");
+
+  if (!ok)
+    l.loge("The batch was aborted after a GPU error\n");
+  return ok && !n.failed.load();
+}
+
+namespace {
+void load_stage(context *c, std::atomic<std::size_t> *next,
+                std::atomic<std::size_t> *active, channel<loaded_job> *out,
+                counters *n) {
+  logger l{c->log_level};
+  const auto trace = c->trace.get();
+  if (trace)
+    trace->name_thread("batch_loader");
+
+  for (auto i = next->fetch_add(1); i < c->jobs.size();
+       i = next->fetch_add(1)) {
+    const auto &j = c->jobs[i];
+    std::vector<std::vector<vtype>> data{};
+    bool read{};
+    {
+      trace_scope span{trace, "read_matrix"};
+      read = read_matrix(j.matrix_file, &data);
+    }
+    if (!read) {
+      l.loge("Failed to read matrix from source file: ", j.matrix_file, "\n");
+      ++n->failed;
+      continue;
+    }
+
+    if (!data.size()) {
+      l.loge("Cannot render an empty matrix: ", j.matrix_file, "\n");
+      ++n->failed;
+      continue;
+    }
+
+    loaded_job e{.output_file = j.output_file};
+    {
+      trace_scope span{trace, "normalize_matrix"};
+      e.vertices =
+          normalize_matrix(data, j.compress, j.red, j.green, j.blue, nullptr);
+    }
+    e.matrices = make_transformation(c->window_width, c->window_height,
+                                     e.vertices.size());
+    ++n->loaded;
+
+    if (!out->push(std::move(e)))
+      break;
+  }
+
+  if (active->fetch_sub(1) == 1)
+    out->close();
+}
+
+void encode_stage(context *c, channel<encode_job> *in, counters *n) {
+  logger l{c->log_level};
+  const auto trace = c->trace.get();
+  if (trace)
+    trace->name_thread("encoder");
+
+  while (auto e = in->pop()) {
+    trace_scope span{trace, "encode"};
+    auto r = image::write(e->output_file, c->window_width, c->window_height,
+                          e->pixels.data());
+    if (r != common::result::success) {
+      l.loge("Failed to write image: ", e->output_file, "\n");
+      ++n->failed;
+      continue;
+    }
+    ++n->written;
+  }
+}
+
+// The slot's previous frame has finished, so its buffer can be replaced. A
+// path too large for the memory budget may be decimated, see budget.cpp.
+bool upload(context *c, uint32_t frame_index, slot *s, loaded_job *j) {
+  const auto a0 = c->allocator.handle;
+  logger l{c->log_level};
+  trace_scope span{c->trace.get(), "upload"};
+
+  if (j->vertices.size() * sizeof(vertex) > s->capacity) {
+    if (!create_vertex_buffer(c, &j->vertices, &s->vertex_buffer))
+      return false;
+    s->capacity = j->vertices.size() * sizeof(vertex);
+  }
+
+  const VkDeviceSize size = j->vertices.size() * sizeof(vertex);
+  if (!fill_vertex_buffer(c, j->vertices, s->vertex_buffer)) {
+    l.loge("Failed to copy vertices to buffer!\n");
+    return false;
+  }
+
+  const auto &ubo = c->per_frame[frame_index].desc_buffer;
+  if (vmaCopyMemoryToAllocation(a0, &j->matrices, ubo.allocation, 0,
+                                sizeof(transformation)) != VK_SUCCESS) {
+    l.loge("Failed to copy matrices to buffer!\n");
+    return false;
+  }
+
+  if (c->trace) {
+    c->trace->counter("vertices", j->vertices.size());
+    c->trace->counter("uploaded_bytes", size + sizeof(transformation));
+  }
+  return true;
+}
+
+void bind_descriptors(context *c) {
+  for (std::size_t i = 0; i < c->concurrent_frames; ++i) {
+    VkDescriptorBufferInfo dbi{.buffer = c->per_frame[i].desc_buffer.handle};
+    dbi.offset = 0;
+    dbi.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet wds{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    wds.descriptorCount = 1;
+    wds.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    wds.pBufferInfo = &dbi;
+    wds.dstSet = c->per_frame[i].descriptor_set;
+    wds.dstBinding = 0;
+    wds.dstArrayElement = 0;
+    vkUpdateDescriptorSets(c->device.handle, 1, &wds, 0, 0);
+  }
+}
+
+// A manifest holds one job per line:
+//   <matrix file> [output=<path>] [red=0-255] [green=0-255] [blue=0-255]
+//                 [compress[=0|1]]
+// Blank lines and everything after '#' are ignored. Options not given on a
+// line fall back to the command line values. Unlike the CYK based command
+// line parser, reading a manifest is linear in its size.
+bool read_manifest(context *c, const fs::path &dir) {
+  logger l{c->log_level};
+  std::ifstream in{c->manifest};
+  if (!in) {
+    l.loge("Failed to open manifest\n");
+    return false;
+  }
+
+  std::string line{}, error{};
+  for (std::size_t n = 1; std::getline(in, line); ++n) {
+    job j{.compress = c->compress};
+    j.red = c->red;
+    j.green = c->green;
+    j.blue = c->blue;
+
+    std::string_view v{line};
+    v = v.substr(0, v.find('#'));
+    if (v.find_first_not_of(" \t\r") == std::string_view::npos)
+      continue;
+
+    if (!parse_job(v, dir, &j, &error)) {
+      l.loge(c->manifest, ":", n, ": ", error, "\n");
+      return false;
+    }
+
+    std::error_code ec{};
+    const auto parent = fs::path{j.output_file}.parent_path();
+    if (!parent.empty() && !fs::create_directories(parent, ec) && ec) {
+      l.loge("Failed to create output directory: ", parent.string(), "\n");
+      return false;
+    }
+    c->jobs.push_back(std::move(j));
+  }
+
+  return true;
+}
+
+bool parse_job(std::string_view line, const fs::path &dir, job *j,
+               std::string *error) {
+  const auto color = [error](std::string_view v, float *out) {
+    unsigned value{};
+    auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), value);
+    if (ec != std::errc{} || end != v.data() + v.size() || value > 255) {
+      *error = "color values must be between 0 and 255";
+      return false;
+    }
+    *out = float(value) / 255.f;
+    return true;
+  };
+
+  constexpr std::string_view space{" \t\r"};
+  for (auto begin = line.find_first_not_of(space);
+       begin != std::string_view::npos;
+       begin = line.find_first_not_of(space, begin)) {
+    auto end = std::min(line.find_first_of(space, begin), line.size());
+    const auto tok = line.substr(begin, end - begin);
+    begin = end;
+
+    if (!j->matrix_file.size()) {
+      j->matrix_file = tok;
+      continue;
+    }
+
+    const auto eq = tok.find('=');
+    const auto key = tok.substr(0, eq);
+    const auto value =
+        eq == std::string_view::npos ? std::string_view{} : tok.substr(eq + 1);
+
+    if (key == "output" && value.size())
+      j->output_file = value;
+    else if (key == "red" && !color(value, &j->red))
+      return false;
+    else if (key == "green" && !color(value, &j->green))
+      return false;
+    else if (key == "blue" && !color(value, &j->blue))
+      return false;
+    else if (key == "compress" && (!value.size() || value == "1"))
+      j->compress = true;
+    else if (key == "compress" && value == "0")
+      j->compress = false;
+    else if (key != "red" && key != "green" && key != "blue") {
+      *error = "unknown or malformed option '" + std::string{tok} + "'";
+      return false;
+    }
+  }
+
+  if (!j->output_file.size())
+    j->output_file = (dir / fs::path{j->matrix_file}.stem()).string() + ".png";
+  return true;
+}
+} // namespace
@@ -0,0 +1,271 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <iterator>
+#include <logger.hpp>
+
+bool create_vertex_buffer(context *c, std::vector<vertex> *vertices,
+                          raii::resource<adapter::vma_buffer> *buffer);
+bool fill_vertex_buffer(context *c, const std::vector<vertex> &vertices,
+                        const raii::resource<adapter::vma_buffer> &buffer);
+
+namespace {
+// Share of a heap's remaining budget a vertex buffer may take, the rest is
+// left to the driver and to allocations made later on
+constexpr double headroom{0.9};
+
+constexpr const char *placement_names[] = {"host visible device", "device",
+                                           "host", "decimated"};
+
+// Placements tried in turn, with the memory types each one may use
+constexpr vertex_placement candidates[] = {vertex_placement::device,
+                                           vertex_placement::staged,
+                                           vertex_placement::host};
+
+VkDeviceSize available(const context *c, vertex_placement placement);
+bool allocate(context *c, VkDeviceSize size, vertex_placement placement,
+              raii::resource<adapter::vma_buffer> *buffer);
+bool copy_staged(context *c, const std::vector<vertex> &vertices,
+                 VkBuffer target);
+void decimate(std::vector<vertex> *vertices, std::size_t count);
+} // namespace
+
+// Replaces *buffer with one that holds *vertices, choosing where it lives
+// from the heap budgets before allocating: device local memory the CPU
+// writes directly if the path fits, e.g. a resizable BAR or unified
+// memory, device local memory filled through a staging copy next, host
+// memory read over the bus after that, and as a last resort a decimated
+// path that fits the largest of the three. The old buffer is released
+// first, so it must no longer be in use by the device.
+bool create_vertex_buffer(context *c, std::vector<vertex> *vertices,
+                          raii::resource<adapter::vma_buffer> *buffer) {
+  logger l{c->log_level};
+  *buffer = raii::resource<adapter::vma_buffer>{};
+
+  const VkDeviceSize size = vertices->size() * sizeof(vertex);
+  VkDeviceSize budgets[std::size(candidates)]{};
+  for (std::size_t i = 0; i < std::size(candidates); ++i)
+    budgets[i] = available(c, candidates[i]);
+
+  const auto largest = *std::max_element(std::begin(budgets),
+                                         std::end(budgets));
+  bool decimated{false};
+  if (size > largest) {
+    const auto count = largest / sizeof(vertex);
+    if (count < 2) {
+      l.loge("No memory heap has room for the vertex buffer\n");
+      return false;
+    }
+    decimate(vertices, count);
+    decimated = true;
+  }
+
+  // The budget is an estimate, an allocation can still be refused, and
+  // then the next placement with room is tried
+  const VkDeviceSize fitted = vertices->size() * sizeof(vertex);
+  std::size_t i{};
+  while (i < std::size(candidates) &&
+         !(fitted <= budgets[i] && allocate(c, fitted, candidates[i], buffer)))
+    ++i;
+  if (i == std::size(candidates)) {
+    l.loge("Failed to create vk buffer using VMA\n");
+    return false;
+  }
+
+  const auto placement = decimated ? vertex_placement::decimated
+                                   : candidates[i];
+  c->placement = placement;
+  const auto name = placement_names[static_cast<std::size_t>(placement)];
+  if (placement == vertex_placement::device ||
+      placement == vertex_placement::staged) {
+    l.logi("Vertex buffer of ", fitted >> 20, " MiB placed in ", name,
+           " memory\n");
+    return true;
+  }
+
+  // Degraded rendering should not go unnoticed
+  const auto device = std::max(budgets[0], budgets[1]);
+  logger w{c->log_level | logger::wrn};
+  w.logw(size >> 20, " MiB of vertices exceed the device local budget of ",
+         device >> 20, " MiB, the vertex buffer is ", name, "\n");
+  if (placement == vertex_placement::decimated)
+    w.logw("Drawing ", vertices->size(), " vertices of the path\n");
+  return true;
+}
+
+// Copies vertices to the start of buffer, directly when its memory is host
+// visible and through a staging buffer otherwise. The device must no longer
+// read the buffer, and the copy is done when this returns.
+bool fill_vertex_buffer(context *c, const std::vector<vertex> &vertices,
+                        const raii::resource<adapter::vma_buffer> &buffer) {
+  const auto a0 = c->allocator.handle;
+  VkMemoryPropertyFlags flags{};
+  vmaGetAllocationMemoryProperties(a0, buffer.allocation, &flags);
+  if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+    return copy_staged(c, vertices, buffer.handle);
+
+  return vmaCopyMemoryToAllocation(a0, vertices.data(), buffer.allocation, 0,
+                                   vertices.size() * sizeof(vertex)) ==
+         VK_SUCCESS;
+}
+
+namespace {
+// Remaining budget of the heaps a vertex buffer with the given placement
+// can be placed in. Without a resizable BAR the host visible device local
+// heap is small, so the device local types the CPU cannot map count too,
+// as a placement of their own.
+VkDeviceSize available(const context *c, vertex_placement placement) {
+  const VkPhysicalDeviceMemoryProperties *props{};
+  vmaGetMemoryProperties(c->allocator.handle, &props);
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+  vmaGetHeapBudgets(c->allocator.handle, budgets);
+
+  const bool device_local = placement != vertex_placement::host;
+  const bool host_visible = placement != vertex_placement::staged;
+  VkDeviceSize best{};
+  for (uint32_t i = 0; i < props->memoryTypeCount; ++i) {
+    const auto flags = props->memoryTypes[i].propertyFlags;
+    const bool local = flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const bool visible = flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    if (local != device_local || visible != host_visible)
+      continue;
+
+    const auto &b = budgets[props->memoryTypes[i].heapIndex];
+    if (b.budget > b.usage)
+      best = std::max(best, VkDeviceSize((b.budget - b.usage) * headroom));
+  }
+  return best;
+}
+
+bool allocate(context *c, VkDeviceSize size, vertex_placement placement,
+              raii::resource<adapter::vma_buffer> *buffer) {
+  const auto a0 = c->allocator.handle;
+
+  VkBufferCreateInfo vb{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  vb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  vb.size = size;
+  vb.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+  // Within budget, so an allocation that would push the process past it
+  // fails here instead of paging later on
+  VmaAllocationCreateInfo aci{};
+  aci.usage = placement == vertex_placement::host
+                  ? VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+                  : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  aci.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+  if (placement != vertex_placement::staged)
+    aci.flags |= VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+  if (placement != vertex_placement::host)
+    aci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+  VkBuffer vbuf{};
+  VmaAllocation valloc{};
+  if (vmaCreateBuffer(a0, &vb, &aci, &vbuf, &valloc, 0) != VK_SUCCESS)
+    return false;
+
+  vmaSetAllocationName(a0, valloc, "vertices");
+  *buffer = raii::resource<adapter::vma_buffer>{a0, valloc, vbuf};
+  return true;
+}
+
+// Fills a device local buffer the CPU cannot map. The copy is submitted
+// on its own and waited for, followed by a barrier that makes it visible
+// to the vertex input and the compute rasterizer of later submissions.
+bool copy_staged(context *c, const std::vector<vertex> &vertices,
+                 VkBuffer target) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+  const auto a0 = c->allocator.handle;
+  const VkDeviceSize size = vertices.size() * sizeof(vertex);
+
+  VkBufferCreateInfo sb{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  sb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  sb.size = size;
+  sb.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+  VmaAllocationCreateInfo aci{};
+  aci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+  aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+  VkBuffer sbuf{};
+  VmaAllocation salloc{};
+  if (vmaCreateBuffer(a0, &sb, &aci, &sbuf, &salloc, 0) != VK_SUCCESS) {
+    l.loge("Failed to create the vertex staging buffer\n");
+    return false;
+  }
+  vmaSetAllocationName(a0, salloc, "vertex staging");
+  raii::resource<adapter::vma_buffer> staging{a0, salloc, sbuf};
+  if (vmaCopyMemoryToAllocation(a0, vertices.data(), salloc, 0, size) !=
+      VK_SUCCESS)
+    return false;
+
+  VkCommandBufferAllocateInfo cbinfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cbinfo.commandPool = c->graphics_command_pool.handle;
+  cbinfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cbinfo.commandBufferCount = 1;
+
+  VkCommandBuffer cb{};
+  if (vkAllocateCommandBuffers(dev, &cbinfo, &cb) != VK_SUCCESS) {
+    l.loge("Failed to allocate the vertex upload command buffer\n");
+    return false;
+  }
+
+  VkCommandBufferBeginInfo begin{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cb, &begin);
+  const VkBufferCopy region{.size = size};
+  vkCmdCopyBuffer(cb, sbuf, target, 1, &region);
+
+  VkMemoryBarrier2 copied{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  copied.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  copied.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  copied.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT |
+                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  copied.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT |
+                         VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+  VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  dependency.memoryBarrierCount = 1;
+  dependency.pMemoryBarriers = &copied;
+  vkCmdPipelineBarrier2(cb, &dependency);
+  vkEndCommandBuffer(cb);
+
+  VkFenceCreateInfo finfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkFence handle{};
+  if (vkCreateFence(dev, &finfo, nullptr, &handle) != VK_SUCCESS) {
+    vkFreeCommandBuffers(dev, cbinfo.commandPool, 1, &cb);
+    l.loge("Failed to create the vertex upload fence\n");
+    return false;
+  }
+  raii::resource<adapter::vk_fence> fence{dev, handle};
+
+  VkSubmitInfo sinfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  sinfo.commandBufferCount = 1;
+  sinfo.pCommandBuffers = &cb;
+
+  auto r = vkQueueSubmit(c->graphics_queue, 1, &sinfo, handle);
+  if (r == VK_SUCCESS)
+    r = vkWaitForFences(dev, 1, &handle, VK_TRUE, UINT64_MAX);
+  vkFreeCommandBuffers(dev, cbinfo.commandPool, 1, &cb);
+  if (r != VK_SUCCESS) {
+    l.loge("Failed to copy vertices through the staging buffer with code: ",
+           r, "\n");
+    return false;
+  }
+  return true;
+}
+
+// Keeps count vertices evenly spread along the path, including both ends,
+// so the decimated path still runs from the smallest to the largest element
+void decimate(std::vector<vertex> *vertices, std::size_t count) {
+  auto &v = *vertices;
+  if (count >= v.size())
+    return;
+
+  for (std::size_t i = 0; i < count; ++i)
+    v[i] = v[i * (v.size() - 1) / (count - 1)];
+  v.resize(count);
+}
+} // namespace
@@ -0,0 +1,186 @@
+#include "sigil.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <logger.hpp>
+#include <random>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+bool create_pipeline_cache(context *c);
+void save_pipeline_cache(context *c);
+
+namespace {
+// Prepended to the driver's cache data. Drivers are meant to reject foreign
+// data themselves, but not all of them do so gracefully, so nothing reaches
+// vkCreatePipelineCache unless it was written for this exact device and
+// driver build, and only if its checksum shows the data arrived whole.
+struct cache_header {
+  char magic[4]{'S', 'G', 'P', 'C'};
+  uint32_t header_size{sizeof(cache_header)};
+  uint32_t vendor_id{};
+  uint32_t device_id{};
+  uint32_t driver_version{};
+  uint8_t uuid[VK_UUID_SIZE]{};
+  uint32_t checksum{}; // FNV-1a of the data
+  uint64_t data_size{};
+};
+
+cache_header make_header(const VkPhysicalDeviceProperties &p);
+uint32_t checksum(const char *data, std::size_t size);
+bool is_valid(const cache_header &expected, const cache_header &h,
+              std::size_t file_size);
+fs::path cache_path(const VkPhysicalDeviceProperties &p);
+} // namespace
+
+// Creates c->pipeline_cache, seeded from the per user cache file when it
+// matches the device. A missing or stale file is not an error, the cache
+// then starts out empty and the pipelines are compiled from scratch.
+bool create_pipeline_cache(context *c) {
+  logger l{c->log_level};
+  const auto &props = c->device_capabilities.properties;
+  const auto path = cache_path(props);
+  const auto expected = make_header(props);
+
+  std::vector<char> file{};
+  if (!path.empty()) {
+    std::ifstream in{path, std::ios::binary};
+    file.assign(std::istreambuf_iterator<char>{in}, {});
+  }
+
+  cache_header h{};
+  const char *data{};
+  if (file.size() >= sizeof(h)) {
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (is_valid(expected, h, file.size()) &&
+        h.checksum == checksum(file.data() + sizeof(h), h.data_size))
+      data = file.data() + sizeof(h);
+    else
+      l.logw("Ignoring stale pipeline cache: ", path.string(), "\n");
+  }
+
+  VkPipelineCacheCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  info.initialDataSize = data ? h.data_size : 0;
+  info.pInitialData = data;
+
+  VkPipelineCache handle{};
+  auto r = vkCreatePipelineCache(c->device.handle, &info, nullptr, &handle);
+  if (r != VK_SUCCESS) {
+    l.loge("Failed to create pipeline cache with code: ", r, "\n");
+    return false;
+  }
+
+  c->pipeline_cache =
+      raii::resource<adapter::vk_pipeline_cache>{c->device.handle, handle};
+  c->pipeline_cache_size = info.initialDataSize;
+  if (data)
+    l.logi("Loaded pipeline cache: ", path.string(), " (", h.data_size,
+           " bytes)\n");
+  return true;
+}
+
+// Writes the cache back once every pipeline has been created, so later runs
+// skip shader compilation. The file is replaced atomically and left alone
+// when nothing new was compiled. Failing to save only costs time on the
+// next run, so it is reported as a warning. Parallel runs may save at the
+// same time, so each writes its own temporary file.
+void save_pipeline_cache(context *c) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+  const VkPipelineCache cache = c->pipeline_cache.handle;
+  if (!cache)
+    return;
+
+  std::size_t size{};
+  if (vkGetPipelineCacheData(dev, cache, &size, nullptr) != VK_SUCCESS ||
+      size == c->pipeline_cache_size)
+    return;
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(dev, cache, &size, data.data()) != VK_SUCCESS)
+    return;
+
+  const auto &props = c->device_capabilities.properties;
+  const auto path = cache_path(props);
+  if (path.empty())
+    return;
+
+  auto h = make_header(props);
+  h.data_size = size;
+  h.checksum = checksum(data.data(), size);
+
+  std::error_code ec{};
+  fs::create_directories(path.parent_path(), ec);
+  auto tmp = path;
+  tmp += "." + std::to_string(std::random_device{}()) + ".tmp";
+
+  {
+    std::ofstream out{tmp, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    out.write(data.data(), size);
+    if (!out) {
+      l.logw("Failed to write pipeline cache: ", tmp.string(), "\n");
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    l.logw("Failed to save pipeline cache: ", path.string(), "\n");
+    fs::remove(tmp, ec);
+    return;
+  }
+
+  c->pipeline_cache_size = size;
+  l.logi("Saved pipeline cache: ", path.string(), " (", size, " bytes)\n");
+}
+
+namespace {
+cache_header make_header(const VkPhysicalDeviceProperties &p) {
+  cache_header h{};
+  h.vendor_id = p.vendorID;
+  h.device_id = p.deviceID;
+  h.driver_version = p.driverVersion;
+  std::memcpy(h.uuid, p.pipelineCacheUUID, VK_UUID_SIZE);
+  return h;
+}
+
+uint32_t checksum(const char *data, std::size_t size) {
+  uint32_t hash{2166136261u};
+  for (std::size_t i = 0; i < size; ++i)
+    hash = (hash ^ uint8_t(data[i])) * 16777619u;
+  return hash;
+}
+
+bool is_valid(const cache_header &expected, const cache_header &h,
+              std::size_t file_size) {
+  return !std::memcmp(h.magic, expected.magic, sizeof(h.magic)) &&
+         h.header_size == expected.header_size &&
+         h.vendor_id == expected.vendor_id &&
+         h.device_id == expected.device_id &&
+         h.driver_version == expected.driver_version &&
+         !std::memcmp(h.uuid, expected.uuid, VK_UUID_SIZE) &&
+         h.data_size == file_size - sizeof(h);
+}
+
+// $XDG_CACHE_HOME/sigil, falling back to ~/.cache/sigil. One file per
+// device, so machines with several GPUs do not keep evicting each other.
+fs::path cache_path(const VkPhysicalDeviceProperties &p) {
+  fs::path dir{};
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+    dir = xdg;
+  else if (const char *home = std::getenv("HOME"); home && *home)
+    dir = fs::path{home} / ".cache";
+  else
+    return {};
+
+  const auto name = "pipelines-" + std::to_string(p.vendorID) + "-" +
+                    std::to_string(p.deviceID) + ".bin";
+  return dir / "sigil" / name;
+}
+} // namespace
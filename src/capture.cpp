@@ -0,0 +1,182 @@
+#include "sigil.hpp"
+#include <filesystem>
+#include <image.hpp>
+#include <logger.hpp>
+#include <string>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+void add_capture_pass(context *c, uint32_t frame_index, uint32_t image);
+void collect_capture(context *c, uint32_t frame_index);
+
+namespace {
+bool is_capturable(VkFormat format);
+bool is_bgra(VkFormat format);
+std::string make_capture_name(context *c);
+void encode(std::size_t log_level, channel<capture_job> *in);
+bool write_capture(const capture_job &j, const uint8_t *mapped);
+} // namespace
+
+// Adds a pass copying image, the frame's swapchain image in the graph,
+// into the frame's readback buffer. The copy follows the frame's other
+// passes, so capturing costs one transfer on the GPU and nothing on the
+// render thread, see collect_capture. A frame takes no new capture while
+// its buffer is still being encoded.
+void add_capture_pass(context *c, uint32_t frame_index, uint32_t image) {
+  auto &frame = c->per_frame[frame_index];
+  if (!c->capture_frames || !c->capture_supported ||
+      frame.capture_file.size())
+    return;
+
+  logger l{c->log_level};
+  if (!is_capturable(c->surface_format.format)) {
+    l.logw("Captures are not supported for the swapchain format\n");
+    c->capture_frames = 0;
+    return;
+  }
+
+  // The host reads the buffer once the frame's fence has signaled
+  auto &g = c->graph;
+  graph_use host{.stages = VK_PIPELINE_STAGE_2_HOST_BIT};
+  host.access = VK_ACCESS_2_HOST_READ_BIT;
+  const auto dst = g.import_buffer("readback", frame.readback_buffer.handle,
+                                   {}, host);
+
+  graph_use src{.resource = image};
+  src.stages = VK_PIPELINE_STAGE_2_COPY_BIT;
+  src.access = VK_ACCESS_2_TRANSFER_READ_BIT;
+  src.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+  graph_use copy{.resource = dst};
+  copy.stages = VK_PIPELINE_STAGE_2_COPY_BIT;
+  copy.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+  const auto record = [c, image, dst](VkCommandBuffer rb,
+                                      const frame_graph &g) {
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {c->window_width, c->window_height, 1};
+    vkCmdCopyImageToBuffer(rb, g.resources[image].image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           g.resources[dst].buffer, 1, &region);
+  };
+  g.add_pass("capture", {src, copy}, record);
+
+  frame.capture_file = make_capture_name(c);
+  --c->capture_frames;
+}
+
+// Hands a finished capture to the encoder thread, which reads the frame's
+// readback buffer in place, and releases the frame once the encoder is
+// done. Must only be called after the frame's fence has signaled. If the
+// encoder falls behind the capture is dropped rather than stalling the
+// render loop.
+void collect_capture(context *c, uint32_t frame_index) {
+  auto &frame = c->per_frame[frame_index];
+  if (!frame.capture_file.size())
+    return;
+
+  if (frame.capture_queued) {
+    if (frame.capture_encoding.load(std::memory_order_acquire))
+      return;
+    frame.capture_queued = false;
+    frame.capture_file.clear();
+    return;
+  }
+
+  capture_job j{.output_file = frame.capture_file};
+  j.allocator = c->allocator.handle;
+  j.pixels = frame.readback_buffer.allocation;
+  j.width = c->window_width;
+  j.height = c->window_height;
+  j.bgra = is_bgra(c->surface_format.format);
+  j.encoding = &frame.capture_encoding;
+
+  if (!c->capture) {
+    c->capture = std::make_unique<capture_queue>();
+    c->capture->encoder =
+        std::jthread{encode, c->log_level, &c->capture->jobs};
+  }
+
+  frame.capture_encoding.store(true, std::memory_order_relaxed);
+  if (!c->capture->jobs.try_push(std::move(j))) {
+    frame.capture_encoding.store(false, std::memory_order_relaxed);
+    frame.capture_file.clear();
+    logger l{c->log_level};
+    l.logw("Capture encoder is busy, dropped a frame\n");
+    return;
+  }
+  frame.capture_queued = true;
+}
+
+namespace {
+bool is_capturable(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool is_bgra(VkFormat format) {
+  return format == VK_FORMAT_B8G8R8A8_UNORM ||
+         format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+std::string make_capture_name(context *c) {
+  auto n = std::to_string(c->capture_count++);
+  if (n.size() < 5)
+    n.insert(0, 5 - n.size(), '0');
+
+  const fs::path dir{c->output_file.size() ? c->output_file : "."};
+  return (dir / ("sigil-" + n + ".png")).string();
+}
+
+void encode(std::size_t log_level, channel<capture_job> *in) {
+  logger l{log_level};
+
+  while (auto j = in->pop()) {
+    void *mapped{};
+    bool ok = vmaInvalidateAllocation(j->allocator, j->pixels, 0,
+                                      VK_WHOLE_SIZE) == VK_SUCCESS &&
+              vmaMapMemory(j->allocator, j->pixels, &mapped) == VK_SUCCESS;
+    if (ok) {
+      ok = write_capture(*j, static_cast<const uint8_t *>(mapped));
+      vmaUnmapMemory(j->allocator, j->pixels);
+    }
+    j->encoding->store(false, std::memory_order_release);
+
+    if (!ok) {
+      l.loge("Failed to write capture: ", j->output_file, "\n");
+      continue;
+    }
+    l.logi("Wrote capture ", j->output_file, "\n");
+  }
+}
+
+// BGRA frames are swizzled in a copy, the host never writes to the
+// readback buffer
+bool write_capture(const capture_job &j, const uint8_t *mapped) {
+  std::error_code ec{};
+  const auto parent = fs::path{j.output_file}.parent_path();
+  if (!parent.empty())
+    fs::create_directories(parent, ec);
+
+  std::vector<uint8_t> rgba{};
+  if (j.bgra) {
+    rgba.assign(mapped, mapped + std::size_t{j.width} * j.height * 4);
+    for (std::size_t i = 0; i + 3 < rgba.size(); i += 4)
+      std::swap(rgba[i], rgba[i + 2]);
+    mapped = rgba.data();
+  }
+
+  return image::write(j.output_file, j.width, j.height, mapped) ==
+         common::result::success;
+}
+} // namespace
@@ -35,6 +35,44 @@ void add_green_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
                     const cfg::action_t &count);
 void add_blue_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
                    const cfg::action_t &count);
+void add_headless_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count);
+void add_output_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count);
+void add_batch_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count);
+void add_manifest_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count);
+void add_capture_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count);
+void add_export_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count);
+void add_software_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count);
+void add_compute_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count);
+void add_density_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count);
+void add_progressive_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                          const cfg::action_t &count);
+void add_timings_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count);
+void add_gpu_timing_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                         const cfg::action_t &count);
+void add_stats_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count);
+void add_trace_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count);
+void add_memory_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count);
+void add_range_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count);
+void add_play_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                   const cfg::action_t &count);
+void add_sequence_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count);
+void add_keyframe_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count);
 } // namespace
 
 bool parse_cli(context *c, int argc, char **argv) {
@@ -77,6 +115,25 @@ bool parse_cli(context *c, int argc, char **argv) {
   add_red_rule(c, g, m, count);
   add_green_rule(c, g, m, count);
   add_blue_rule(c, g, m, count);
+  add_headless_rule(c, g, m, count);
+  add_output_rule(c, g, m, count);
+  add_batch_rule(c, g, m, count);
+  add_manifest_rule(c, g, m, count);
+  add_capture_rule(c, g, m, count);
+  add_export_rule(c, g, m, count);
+  add_software_rule(c, g, m, count);
+  add_compute_rule(c, g, m, count);
+  add_density_rule(c, g, m, count);
+  add_progressive_rule(c, g, m, count);
+  add_timings_rule(c, g, m, count);
+  add_gpu_timing_rule(c, g, m, count);
+  add_stats_rule(c, g, m, count);
+  add_trace_rule(c, g, m, count);
+  add_memory_rule(c, g, m, count);
+  add_range_rule(c, g, m, count);
+  add_play_rule(c, g, m, count);
+  add_sequence_rule(c, g, m, count);
+  add_keyframe_rule(c, g, m, count);
 
   add_rule(&g, "start", "arg", "arg_list");
   add_rule(&g, "arg_list", "arg", "arg_list");
@@ -90,15 +147,117 @@ bool parse_cli(context *c, int argc, char **argv) {
   add_rule(&g, "red#0", "red");
   add_rule(&g, "green#0", "green");
   add_rule(&g, "blue#0", "blue");
+  add_rule(&g, "output-option#0", "output-option");
+  add_rule(&g, "batch-option#0", "batch-option");
+  add_rule(&g, "manifest-option#0", "manifest-option");
+  add_rule(&g, "capture-option#0", "capture-option");
+  add_rule(&g, "export-option#0", "export-option");
+  add_rule(&g, "timings-option#0", "timings-option");
+  add_rule(&g, "trace-option#0", "trace-option");
+  add_rule(&g, "memory-option#0", "memory-option");
+  add_rule(&g, "range-option#0", "range-option");
+  add_rule(&g, "play-option#0", "play-option");
+  add_rule(&g, "sequence-option#0", "sequence-option");
+  add_rule(&g, "keyframe-option#0", "keyframe-option");
 
   if (!validate(&input, tbl, g, m, occmap))
     return false;
 
+  // Exported frames go to stdout, so it must not carry any log output
+  if (c->export_frames && c->output_file == "-")
+    c->log_level &= ~logger::inf;
+
   print_summary(c);
   return true;
 }
 
 namespace {
+void add_batch_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->batch = s->value;
+    c->headless = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "batch-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "batch-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "batch-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_manifest_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->manifest = s->value;
+    c->headless = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "manifest-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "manifest-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "manifest-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_output_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count) {
+  {
+    auto r = add_rule(&g, "start", "output-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *s) { c->output_file = s->value; });
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "output-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *s) { c->output_file = s->value; });
+  }
+  {
+    auto r = add_rule(&g, "arg", "output-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *s) { c->output_file = s->value; });
+  }
+}
+
+void add_headless_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count) {
+  {
+    auto r = add_rule(&g, "start", "headless-flag");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *) { c->headless = true; });
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "headless-flag");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *) { c->headless = true; });
+  }
+  {
+    auto r = add_rule(&g, "arg", "headless-flag");
+    bind(&m, r, count);
+    bind(&m, r, [c](auto *, auto *, auto *) { c->headless = true; });
+  }
+}
+
 void add_blue_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
                    const cfg::action_t &count) {
   std::string col{"blue#0"};
@@ -327,6 +486,354 @@ void add_compress_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
   }
 }
 
+void add_capture_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->capture_frames = std::stoull(s->value);
+  };
+
+  {
+    auto r = add_rule(&g, "start", "capture-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "capture-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "capture-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_export_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->export_frames = std::stoull(s->value);
+    c->headless = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "export-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "export-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "export-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_software_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->software = true;
+    c->headless = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "software-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "software-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "software-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_compute_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->compute = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "compute-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "compute-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "compute-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_density_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->compute = true;
+    c->density = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "density-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "density-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "density-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_progressive_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                          const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->progressive = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "progressive-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "progressive-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "progressive-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_timings_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                      const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->timings_file = s->value;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "timings-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "timings-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "timings-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_gpu_timing_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                         const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->gpu_timing = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "gpu-timing-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "gpu-timing-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "gpu-timing-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_stats_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *) {
+    c->stats = true;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "stats-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "stats-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "stats-flag");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_trace_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->trace_file = s->value;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "trace-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "trace-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "trace-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_memory_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                     const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->memory_file = s->value;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "memory-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "memory-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "memory-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_range_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                    const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->range_text = s->value;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "range-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "range-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "range-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_play_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                   const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->play = std::stoull(s->value);
+  };
+
+  {
+    auto r = add_rule(&g, "start", "play-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "play-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "play-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_sequence_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->sequence_file = s->value;
+  };
+
+  {
+    auto r = add_rule(&g, "start", "sequence-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "sequence-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "sequence-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
+void add_keyframe_rule(context *c, cfg::grammar_t &g, cfg::action_map_t &m,
+                       const cfg::action_t &count) {
+  const auto set = [c](auto *, auto *, auto *s) {
+    c->keyframe_ms = std::stoull(s->value);
+  };
+
+  {
+    auto r = add_rule(&g, "start", "keyframe-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg_list", "keyframe-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+  {
+    auto r = add_rule(&g, "arg", "keyframe-option#0", "string-tok#0");
+    bind(&m, r, count);
+    bind(&m, r, set);
+  }
+}
+
 bool validate(const std::vector<std::string> *input,
               const cfg::lexer_table_t &tbl, const cfg::grammar_t &g,
               const cfg::action_map_t &m,
@@ -366,6 +873,7 @@ cfg::lexer_table_t make_lexer_table() {
   cfg::add_entry(&tbl, cfg::token_type::flag, "verbose-flag", "-v|--verbose");
   cfg::add_entry(&tbl, cfg::token_type::flag, "help-flag", "--help");
   cfg::add_entry(&tbl, cfg::token_type::flag, "debug-flag", "-d|--debug");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "headless-flag", "--headless");
   cfg::add_entry(&tbl, cfg::token_type::option, "party-option", "-p|--party");
   cfg::add_entry(&tbl, cfg::token_type::option, "file-option", "-f|--file");
   cfg::add_entry(&tbl, cfg::token_type::option, "width-option", "-w|--width");
@@ -373,6 +881,29 @@ cfg::lexer_table_t make_lexer_table() {
   cfg::add_entry(&tbl, cfg::token_type::option, "red", "-r|--red");
   cfg::add_entry(&tbl, cfg::token_type::option, "green", "-g|--green");
   cfg::add_entry(&tbl, cfg::token_type::option, "blue", "-b|--blue");
+  cfg::add_entry(&tbl, cfg::token_type::option, "output-option", "-o|--output");
+  cfg::add_entry(&tbl, cfg::token_type::option, "batch-option", "--batch");
+  cfg::add_entry(&tbl, cfg::token_type::option, "manifest-option",
+                 "--manifest");
+  cfg::add_entry(&tbl, cfg::token_type::option, "capture-option", "--capture");
+  cfg::add_entry(&tbl, cfg::token_type::option, "export-option", "--export");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "software-flag", "--software");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "compute-flag", "--compute");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "density-flag", "--density");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "progressive-flag",
+                 "--progressive");
+  cfg::add_entry(&tbl, cfg::token_type::option, "timings-option", "--timings");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "gpu-timing-flag",
+                 "--gpu-timing");
+  cfg::add_entry(&tbl, cfg::token_type::flag, "stats-flag", "--stats");
+  cfg::add_entry(&tbl, cfg::token_type::option, "trace-option", "--trace");
+  cfg::add_entry(&tbl, cfg::token_type::option, "memory-option", "--memory");
+  cfg::add_entry(&tbl, cfg::token_type::option, "range-option", "--range");
+  cfg::add_entry(&tbl, cfg::token_type::option, "play-option", "--play");
+  cfg::add_entry(&tbl, cfg::token_type::option, "sequence-option",
+                 "--sequence");
+  cfg::add_entry(&tbl, cfg::token_type::option, "keyframe-option",
+                 "--keyframe");
   cfg::add_entry(&tbl, cfg::token_type::free, "size-tok", "[1-9]\\d{2,3}");
   cfg::add_entry(&tbl, cfg::token_type::free, "string-tok", ".+");
   return tbl;
@@ -388,6 +919,25 @@ void print_summary(context *c) {
   l.logs("\twindow width: ", c->window_width, "\n");
   l.logs("\twindow height: ", c->window_height, "\n");
   l.logs("\tmatrix file: ", c->matrix_file, "\n");
+  l.logs("\theadless: ", c->headless ? "true" : "false", "\n");
+  l.logs("\toutput file: ", c->output_file, "\n");
+  l.logs("\tbatch: ", c->batch, "\n");
+  l.logs("\tmanifest: ", c->manifest, "\n");
+  l.logs("\tcapture frames: ", c->capture_frames, "\n");
+  l.logs("\texport frames: ", c->export_frames, "\n");
+  l.logs("\tsoftware: ", c->software ? "true" : "false", "\n");
+  l.logs("\tcompute: ", c->compute ? "true" : "false", "\n");
+  l.logs("\tdensity: ", c->density ? "true" : "false", "\n");
+  l.logs("\tprogressive: ", c->progressive ? "true" : "false", "\n");
+  l.logs("\ttimings: ", c->timings_file, "\n");
+  l.logs("\tgpu timing: ", c->gpu_timing ? "true" : "false", "\n");
+  l.logs("\tstats: ", c->stats ? "true" : "false", "\n");
+  l.logs("\ttrace: ", c->trace_file, "\n");
+  l.logs("\tmemory: ", c->memory_file, "\n");
+  l.logs("\trange: ", c->range_text, "\n");
+  l.logs("\tplay: ", c->play, "\n");
+  l.logs("\tsequence: ", c->sequence_file, "\n");
+  l.logs("\tkeyframe: ", c->keyframe_ms, " ms\n");
   l.logs("\tsigil color: ", c->red, ", ", c->green, ", ", c->blue, "\n");
 }
 } // namespace
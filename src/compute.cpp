@@ -0,0 +1,332 @@
+#include "sigil.hpp"
+#include <logger.hpp>
+#include <raster_shader.h>
+#include <resolve_shader.h>
+#include <span>
+
+bool create_compute(context *c);
+void add_compute_passes(context *c, uint32_t frame_index, VkBuffer vertices,
+                        draw_range range, uint32_t target);
+bool create_shader_module(VkDevice dev, std::span<const uint32_t> src,
+                          raii::resource<adapter::vk_shader_module> *mod);
+
+namespace {
+// Mirrors the push constant block of raster.comp and resolve.comp
+struct parameters {
+  uint32_t vertex_count{};
+  uint32_t width{};
+  uint32_t height{};
+  uint32_t density{};
+  uint32_t first_vertex{};
+};
+
+// Hits at which a pixel reaches ~63% brightness in density mode
+constexpr uint32_t density_scale{4};
+
+bool create_compute_layout(context *c);
+bool create_compute_pipeline(context *c, std::span<const uint32_t> src,
+                             raii::resource<adapter::vk_pipeline> *pipeline);
+bool create_compute_targets(context *c);
+void write_compute_set(context *c, uint32_t frame_index, VkBuffer vertices,
+                       VkImageView resolve);
+} // namespace
+
+// Sets up the compute rasterizer: raster.comp draws every path segment
+// into a per frame buffer of packed 64 bit depth and color values,
+// resolve.comp turns that into an RGBA8 storage image, and the image is
+// blitted onto the swapchain image or the offscreen target. The storage
+// image is a transient of the frame graph, see add_compute_passes.
+bool create_compute(context *c) {
+  logger l{c->log_level};
+
+  if (!create_compute_layout(c)) {
+    l.loge("Failed to create the compute pipeline layout\n");
+    return false;
+  }
+
+  auto &raster = c->raster_pipeline;
+  auto &resolve = c->resolve_pipeline;
+  if (!create_compute_pipeline(c, raster_shader_spv, &raster) ||
+      !create_compute_pipeline(c, resolve_shader_spv, &resolve)) {
+    l.loge("Failed to create the compute pipelines\n");
+    return false;
+  }
+
+  if (!create_compute_targets(c)) {
+    l.loge("Failed to create the compute targets\n");
+    return false;
+  }
+
+  return true;
+}
+
+// Adds the compute path to the frame graph, drawing the segments of range
+// into target. The resolve image is a graph transient: it lives between the
+// resolve and the blit only, so its memory can be shared with other
+// transients.
+void add_compute_passes(context *c, uint32_t frame_index, VkBuffer vertices,
+                        draw_range range, uint32_t target) {
+  auto &g = c->graph;
+  auto &frame = c->per_frame[frame_index];
+  const auto raster =
+      g.import_buffer("raster", frame.raster_buffer.handle, {}, {});
+
+  VkImageCreateInfo info{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  info.imageType = VK_IMAGE_TYPE_2D;
+  info.arrayLayers = 1;
+  info.extent = {c->window_width, c->window_height, 1};
+  info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  info.mipLevels = 1;
+  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  info.samples = VK_SAMPLE_COUNT_1_BIT;
+  const auto resolve =
+      g.transient_image("resolve", info, VK_IMAGE_ASPECT_COLOR_BIT);
+
+  parameters p{.vertex_count = range.count};
+  p.first_vertex = range.first;
+  p.width = c->window_width;
+  p.height = c->window_height;
+  p.density = c->density ? density_scale : 0;
+
+  // All ones is an empty pixel: its depth bits are behind everything
+  graph_use clear{.resource = raster};
+  clear.stages = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+  clear.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  const uint32_t empty = c->density ? 0 : ~0u;
+  g.add_pass("clear_raster", {clear},
+             [raster, empty](VkCommandBuffer rb, const frame_graph &g) {
+               vkCmdFillBuffer(rb, g.resources[raster].buffer, 0,
+                               VK_WHOLE_SIZE, empty);
+             });
+
+  graph_use draw{.resource = raster};
+  draw.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  draw.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  const auto rasterize = [c, frame_index, vertices, resolve,
+                          p](VkCommandBuffer rb, const frame_graph &g) {
+    write_compute_set(c, frame_index, vertices, g.resources[resolve].view);
+    vkCmdBindDescriptorSets(rb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            c->compute_layout.handle, 0, 1,
+                            &c->per_frame[frame_index].compute_set, 0, 0);
+    vkCmdPushConstants(rb, c->compute_layout.handle,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(p), &p);
+    vkCmdBindPipeline(rb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      c->raster_pipeline.handle);
+    if (p.vertex_count > 1)
+      vkCmdDispatch(rb, (p.vertex_count - 1 + 63) / 64, 1, 1);
+  };
+  g.add_pass("raster", {draw}, rasterize);
+
+  graph_use pixels{.resource = raster};
+  pixels.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  pixels.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+  graph_use image{.resource = resolve};
+  image.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  image.access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  image.layout = VK_IMAGE_LAYOUT_GENERAL;
+  g.add_pass("resolve", {pixels, image},
+             [c, p](VkCommandBuffer rb, const frame_graph &) {
+               vkCmdBindPipeline(rb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 c->resolve_pipeline.handle);
+               vkCmdDispatch(rb, (p.width + 7) / 8, (p.height + 7) / 8, 1);
+             });
+
+  graph_use src{.resource = resolve};
+  src.stages = VK_PIPELINE_STAGE_2_BLIT_BIT;
+  src.access = VK_ACCESS_2_TRANSFER_READ_BIT;
+  src.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  graph_use dst{.resource = target};
+  dst.stages = VK_PIPELINE_STAGE_2_BLIT_BIT;
+  dst.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  dst.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  const auto blit = [resolve, target, p](VkCommandBuffer rb,
+                                         const frame_graph &g) {
+    const auto w = int32_t(p.width), h = int32_t(p.height);
+    VkImageBlit region{};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffsets[1] = {w, h, 1};
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffsets[1] = {w, h, 1};
+    vkCmdBlitImage(rb, g.resources[resolve].image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   g.resources[target].image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                   VK_FILTER_NEAREST);
+  };
+  g.add_pass("blit", {src, dst}, blit);
+}
+
+namespace {
+bool create_compute_layout(context *c) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+
+  VkDescriptorSetLayoutBinding bindings[4]{};
+  const VkDescriptorType types[] = {
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+  for (uint32_t i = 0; i < 4; ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorCount = 1;
+    bindings[i].descriptorType = types[i];
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo li{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  li.bindingCount = 4;
+  li.pBindings = bindings;
+
+  VkDescriptorSetLayout layout{};
+  if (vkCreateDescriptorSetLayout(dev, &li, nullptr, &layout) != VK_SUCCESS) {
+    l.loge("Failed to create compute descriptor set layout\n");
+    return false;
+  }
+  c->compute_desc_layout =
+      raii::resource<adapter::vk_descriptor_set_layout>{dev, layout};
+
+  VkPushConstantRange range{};
+  range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  range.offset = 0;
+  range.size = sizeof(parameters);
+
+  VkPipelineLayoutCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  info.setLayoutCount = 1;
+  info.pSetLayouts = &c->compute_desc_layout.handle;
+  info.pushConstantRangeCount = 1;
+  info.pPushConstantRanges = &range;
+
+  VkPipelineLayout handle{};
+  if (vkCreatePipelineLayout(dev, &info, nullptr, &handle) != VK_SUCCESS)
+    return false;
+  c->compute_layout = raii::resource<adapter::vk_pipeline_layout>{dev, handle};
+
+  const auto n = c->concurrent_frames;
+  VkDescriptorPoolSize sizes[] = {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, n},
+                                  {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * n},
+                                  {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, n}};
+  VkDescriptorPoolCreateInfo pi{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  pi.pPoolSizes = sizes;
+  pi.poolSizeCount = sizeof(sizes) / sizeof(sizes[0]);
+  pi.maxSets = n;
+
+  VkDescriptorPool pool{};
+  if (vkCreateDescriptorPool(dev, &pi, nullptr, &pool) != VK_SUCCESS) {
+    l.loge("Failed to create compute descriptor pool\n");
+    return false;
+  }
+  c->compute_desc_pool = raii::resource<adapter::vk_descriptor_pool>{dev, pool};
+
+  std::array<VkDescriptorSetLayout, context::concurrent_frames> layouts{};
+  layouts.fill(layout);
+  std::array<VkDescriptorSet, context::concurrent_frames> sets{};
+
+  VkDescriptorSetAllocateInfo ai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  ai.descriptorPool = pool;
+  ai.descriptorSetCount = layouts.size();
+  ai.pSetLayouts = layouts.data();
+  if (vkAllocateDescriptorSets(dev, &ai, sets.data()) != VK_SUCCESS) {
+    l.loge("Failed to allocate compute descriptor sets\n");
+    return false;
+  }
+
+  for (std::size_t i = 0; i < c->concurrent_frames; ++i)
+    c->per_frame[i].compute_set = sets[i];
+  return true;
+}
+
+bool create_compute_pipeline(context *c, std::span<const uint32_t> src,
+                             raii::resource<adapter::vk_pipeline> *pipeline) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+
+  raii::resource<adapter::vk_shader_module> mod{};
+  if (!create_shader_module(dev, src, &mod))
+    return false;
+
+  VkComputePipelineCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  info.stage.module = mod.handle;
+  info.stage.pName = "main";
+  info.layout = c->compute_layout.handle;
+
+  VkPipeline handle{};
+  auto r = vkCreateComputePipelines(dev, c->pipeline_cache.handle, 1, &info, 0,
+                                    &handle);
+  if (r != VK_SUCCESS) {
+    l.loge("Failed to create compute pipeline with code: ", r, "\n");
+    return false;
+  }
+
+  *pipeline = raii::resource<adapter::vk_pipeline>{dev, handle};
+  return true;
+}
+
+bool create_compute_targets(context *c) {
+  logger l{c->log_level};
+  const auto a0 = c->allocator.handle;
+
+  VkBufferCreateInfo rb{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  rb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  rb.size = VkDeviceSize{c->window_width} * c->window_height * 8;
+  rb.usage =
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+  VmaAllocationCreateInfo aci{};
+  aci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+  for (auto &frame : c->per_frame) {
+    VmaAllocation alloc{};
+    VkBuffer buf{};
+    if (vmaCreateBuffer(a0, &rb, &aci, &buf, &alloc, 0) != VK_SUCCESS) {
+      l.loge("Failed to create raster buffer using VMA\n");
+      return false;
+    }
+    vmaSetAllocationName(a0, alloc, "raster");
+    frame.raster_buffer = raii::resource<adapter::vma_buffer>{a0, alloc, buf};
+  }
+
+  return true;
+}
+
+// The vertex buffer changes between batch jobs and the resolve image when
+// the graph moves it, so the set is written for every frame. The frame's
+// fence has signaled, so the set is not in use.
+void write_compute_set(context *c, uint32_t frame_index, VkBuffer vertices,
+                       VkImageView resolve) {
+  const auto &frame = c->per_frame[frame_index];
+
+  VkDescriptorBufferInfo buffers[3]{};
+  buffers[0] = {frame.desc_buffer.handle, 0, VK_WHOLE_SIZE};
+  buffers[1] = {vertices, 0, VK_WHOLE_SIZE};
+  buffers[2] = {frame.raster_buffer.handle, 0, VK_WHOLE_SIZE};
+
+  VkDescriptorImageInfo image{};
+  image.imageView = resolve;
+  image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkWriteDescriptorSet writes[4]{};
+  for (uint32_t i = 0; i < 4; ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = frame.compute_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = i < 3 ? &buffers[i] : nullptr;
+  }
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  writes[3].pImageInfo = &image;
+
+  vkUpdateDescriptorSets(c->device.handle, 4, writes, 0, 0);
+}
+} // namespace
@@ -0,0 +1,130 @@
+#include "sigil.hpp"
+#include <channel.hpp>
+#include <chrono>
+#include <numbers>
+#include <fstream>
+#include <iostream>
+#include <logger.hpp>
+#include <thread>
+
+namespace ch = std::chrono;
+
+bool run_export(context *c);
+bool record_offscreen(context *c, uint32_t frame_index, VkBuffer vertices,
+                      draw_range range);
+bool submit_offscreen(context *c, uint32_t frame_index);
+bool read_back(context *c, uint32_t frame_index, std::vector<uint8_t> *pixels);
+void collect_queries(context *c, uint32_t frame_index);
+draw_range visible_range(const context *c);
+
+namespace {
+glm::mat4 turntable(const glm::mat4 &model, std::size_t frame,
+                    std::size_t frames);
+void write_frames(std::ostream *out, channel<std::vector<uint8_t>> *in,
+                  bool *ok);
+} // namespace
+
+// Renders a full turn around the Y axis as c->export_frames raw RGBA frames,
+// written back to back to c->output_file, or to stdout for "-". Every frame
+// slot has its own target and readback buffer, so the GPU renders the next
+// frames while earlier ones are copied out and written by a writer thread.
+// Nothing waits on presentation.
+bool run_export(context *c) {
+  const VkDevice dev = c->device.handle;
+  const auto a0 = c->allocator.handle;
+  const auto frames = c->export_frames;
+  const auto slots = c->concurrent_frames;
+  const auto base = c->matrices.model;
+  logger l{c->log_level};
+
+  std::ofstream file{};
+  std::ostream *out = &std::cout;
+  if (c->output_file != "-") {
+    file.open(c->output_file, std::ios::binary);
+    if (!file) {
+      l.loge("Failed to open export file: ", c->output_file, "\n");
+      return false;
+    }
+    out = &file;
+  }
+
+  bool written{true};
+  channel<std::vector<uint8_t>> pending{slots};
+  std::jthread writer{write_frames, out, &pending, &written};
+  const auto start = ch::steady_clock::now();
+
+  // Frame i is submitted in iteration i and read back in iteration
+  // i + slots, once its slot comes around again
+  bool ok{true};
+  for (std::size_t i = 0; ok && i < frames + slots; ++i) {
+    const uint32_t slot = i % slots;
+    const VkFence f = c->per_frame[slot].presentation_done.handle;
+    if (vkWaitForFences(dev, 1, &f, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+      l.loge("Failed to wait for an export frame\n");
+      ok = false;
+      break;
+    }
+    collect_queries(c, slot);
+
+    if (i >= slots) {
+      std::vector<uint8_t> pixels{};
+      ok = read_back(c, slot, &pixels) && pending.push(std::move(pixels));
+    }
+
+    if (!ok || i >= frames)
+      continue;
+
+    auto m = c->matrices;
+    m.model = turntable(base, i, frames);
+    const auto &ubo = c->per_frame[slot].desc_buffer;
+    if (vmaCopyMemoryToAllocation(a0, &m, ubo.allocation, 0,
+                                  sizeof(transformation)) != VK_SUCCESS) {
+      l.loge("Failed to copy matrices to buffer!\n");
+      ok = false;
+      continue;
+    }
+
+    vkResetFences(dev, 1, &f);
+    ok = record_offscreen(c, slot, c->vertex_buffer.handle,
+                          visible_range(c)) &&
+         submit_offscreen(c, slot);
+  }
+
+  vkDeviceWaitIdle(dev);
+  pending.close();
+  writer.join();
+  out->flush();
+
+  if (!ok || !written || !*out) {
+    l.loge("Export failed\n");
+    return false;
+  }
+
+  const ch::duration<double> elapsed = ch::steady_clock::now() - start;
+  l.logi("Exported ", frames, " frames of ", c->window_width, "x",
+         c->window_height, " RGBA in ", elapsed.count(), " s (",
+         elapsed.count() > 0 ? frames / elapsed.count() : 0.0, " frames/s)\n");
+  return true;
+}
+
+namespace {
+glm::mat4 turntable(const glm::mat4 &model, std::size_t frame,
+                    std::size_t frames) {
+  const auto y_axis = glm::vec3(0.f, 1.f, 0.f);
+  const auto turn = float(frame) / float(frames);
+  const float angle = 2.f * std::numbers::pi_v<float> * turn;
+  return glm::rotate(glm::mat4(1.f), angle, y_axis) * model;
+}
+
+void write_frames(std::ostream *out, channel<std::vector<uint8_t>> *in,
+                  bool *ok) {
+  while (auto pixels = in->pop()) {
+    if (!*ok)
+      continue;
+
+    out->write(reinterpret_cast<const char *>(pixels->data()),
+               pixels->size());
+    *ok = bool(*out);
+  }
+}
+} // namespace
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <image.hpp>
+#include <vector>
+
+using namespace common;
+
+namespace {
+struct bit_writer {
+  std::vector<uint8_t> *out{};
+  uint32_t acc{}, count{};
+
+  void bits(uint32_t value, uint32_t n) {
+    acc |= value << count;
+    count += n;
+    while (count >= 8) {
+      out->push_back(acc & 0xff);
+      acc >>= 8;
+      count -= 8;
+    }
+  }
+
+  // Huffman codes are stored most significant bit first
+  void code(uint32_t value, uint32_t n) {
+    uint32_t rev{};
+    for (uint32_t i = 0; i < n; ++i)
+      rev |= ((value >> i) & 1) << (n - 1 - i);
+    bits(rev, n);
+  }
+
+  void flush() {
+    if (count)
+      out->push_back(acc & 0xff);
+    acc = count = 0;
+  }
+};
+
+void literal(bit_writer *w, uint32_t v) {
+  if (v < 144)
+    w->code(0x30 + v, 8);
+  else if (v < 256)
+    w->code(0x190 + v - 144, 9);
+  else if (v < 280)
+    w->code(v - 256, 7);
+  else
+    w->code(0xc0 + v - 280, 8);
+}
+
+void match(bit_writer *w, uint32_t length, uint32_t distance) {
+  static constexpr uint16_t len_base[] = {
+      3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr uint8_t len_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                          1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                          4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static constexpr uint16_t dist_base[] = {
+      1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+      33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  static constexpr uint8_t dist_extra[] = {0, 0, 0,  0,  1,  1,  2,  2,
+                                           3, 3, 4,  4,  5,  5,  6,  6,
+                                           7, 7, 8,  8,  9,  9,  10, 10,
+                                           11, 11, 12, 12, 13, 13};
+
+  uint32_t l = 28;
+  while (len_base[l] > length)
+    --l;
+  literal(w, 257 + l);
+  w->bits(length - len_base[l], len_extra[l]);
+
+  uint32_t d = 29;
+  while (dist_base[d] > distance)
+    --d;
+  w->code(d, 5);
+  w->bits(distance - dist_base[d], dist_extra[d]);
+}
+
+// A single fixed-Huffman deflate block with greedy LZ77 matching.
+// The rendered images are mostly a flat background, which this
+// compresses well without pulling in zlib.
+void deflate(const std::vector<uint8_t> &in, std::vector<uint8_t> *out) {
+  constexpr uint32_t window = 32768, min_match = 3, max_match = 258;
+  constexpr uint32_t hash_bits = 15;
+  std::vector<int64_t> head(1 << hash_bits, -1);
+
+  auto hash = [&in](std::size_t i) {
+    const uint32_t v = in[i] | (in[i + 1] << 8) | (in[i + 2] << 16);
+    return (v * 2654435761u) >> (32 - hash_bits);
+  };
+
+  bit_writer w{out};
+  w.bits(1, 1); // final block
+  w.bits(1, 2); // fixed Huffman codes
+
+  std::size_t i = 0;
+  while (i < in.size()) {
+    uint32_t length{};
+    std::size_t distance{};
+
+    if (i + min_match <= in.size()) {
+      const auto h = hash(i);
+      const auto candidate = head[h];
+      head[h] = i;
+
+      if (candidate >= 0 && i - candidate <= window) {
+        const auto limit = std::min<std::size_t>(max_match, in.size() - i);
+        while (length < limit && in[candidate + length] == in[i + length])
+          ++length;
+        distance = i - candidate;
+      }
+    }
+
+    if (length >= min_match) {
+      match(&w, length, distance);
+      for (std::size_t k = i + 1; k < i + length; ++k)
+        if (k + min_match <= in.size())
+          head[hash(k)] = k;
+      i += length;
+    } else
+      literal(&w, in[i++]);
+  }
+
+  literal(&w, 256);
+  w.flush();
+}
+
+uint32_t crc32(const uint8_t *data, std::size_t size, uint32_t crc = 0) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+
+  crc = ~crc;
+  for (std::size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t adler32(const std::vector<uint8_t> &data) {
+  uint32_t a = 1, b = 0;
+  for (auto v : data) {
+    a = (a + v) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+void put_u32(std::vector<uint8_t> *out, uint32_t v) {
+  out->push_back(v >> 24);
+  out->push_back(v >> 16);
+  out->push_back(v >> 8);
+  out->push_back(v);
+}
+
+void write_chunk(std::ofstream &file, const char *type,
+                 const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> chunk{};
+  put_u32(&chunk, data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  put_u32(&chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+  file.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+}
+} // namespace
+
+namespace image {
+result write_ppm(const std::string &path, uint32_t width, uint32_t height,
+                 const uint8_t *rgba) {
+  if (!rgba || !width || !height)
+    return result::domain_error;
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return result::access_error;
+
+  file << "P6\n" << width << " " << height << "\n255\n";
+  std::vector<uint8_t> rgb(std::size_t{width} * height * 3);
+  for (std::size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4) {
+    rgb[i] = rgba[j];
+    rgb[i + 1] = rgba[j + 1];
+    rgb[i + 2] = rgba[j + 2];
+  }
+  file.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+
+  if (!file)
+    return result::access_error;
+  return result::success;
+}
+
+result write_png(const std::string &path, uint32_t width, uint32_t height,
+                 const uint8_t *rgba) {
+  if (!rgba || !width || !height)
+    return result::domain_error;
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return result::access_error;
+
+  static constexpr uint8_t signature[] = {0x89, 'P',  'N',  'G',
+                                          '\r', '\n', 0x1a, '\n'};
+  file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+  std::vector<uint8_t> header{};
+  put_u32(&header, width);
+  put_u32(&header, height);
+  header.push_back(8); // bit depth
+  header.push_back(6); // RGBA
+  header.push_back(0); // deflate
+  header.push_back(0); // adaptive filtering
+  header.push_back(0); // no interlace
+  write_chunk(file, "IHDR", header);
+
+  const std::size_t stride = std::size_t{width} * 4;
+  std::vector<uint8_t> raw{};
+  raw.reserve((stride + 1) * height);
+  for (std::size_t y = 0; y < height; ++y) {
+    raw.push_back(0); // filter: none
+    raw.insert(raw.end(), rgba + y * stride, rgba + (y + 1) * stride);
+  }
+
+  std::vector<uint8_t> zlib{0x78, 0x01};
+  deflate(raw, &zlib);
+  put_u32(&zlib, adler32(raw));
+  write_chunk(file, "IDAT", zlib);
+  write_chunk(file, "IEND", {});
+
+  if (!file)
+    return result::access_error;
+  return result::success;
+}
+
+result write(const std::string &path, uint32_t width, uint32_t height,
+             const uint8_t *rgba) {
+  const auto ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+  if (ext == ".ppm" || ext == ".PPM")
+    return write_ppm(path, width, height, rgba);
+  return write_png(path, width, height, rgba);
+}
+} // namespace image
@@ -19,7 +19,7 @@ result instance_specs(specs::vk_instance *s) {
 }
 
 result device_specs(specs::vk_device *s, const VkInstance instance,
-                    const VkPhysicalDevice device) {
+                    const VkPhysicalDevice device, bool presentation) {
 
   if (!s || device == VK_NULL_HANDLE)
     return result::domain_error;
@@ -30,7 +30,18 @@ result device_specs(specs::vk_device *s, const VkInstance instance,
   vkEnumerateDeviceExtensionProperties(device, 0, &count, s->extensions.data());
 
   vkGetPhysicalDeviceProperties(device, &s->properties);
-  vkGetPhysicalDeviceFeatures(device, &s->features);
+  VkPhysicalDeviceFeatures2 features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  s->features12 = {.sType =
+                       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  s->features13 = {.sType =
+                       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+  features.pNext = &s->features12;
+  s->features12.pNext = &s->features13;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+  s->features = features.features;
+  s->features12.pNext = nullptr;
+  s->features13.pNext = nullptr;
 
   std::vector<VkQueueFamilyProperties> qfp{};
   vkGetPhysicalDeviceQueueFamilyProperties(device, &count, 0);
@@ -40,7 +51,8 @@ result device_specs(specs::vk_device *s, const VkInstance instance,
   s->queue_families.resize(qfp.size());
   for (std::size_t i = 0; i < qfp.size(); ++i) {
     s->queue_families[i].properties = qfp[i];
-    if (glfwGetPhysicalDevicePresentationSupport(instance, device, i))
+    if (presentation &&
+        glfwGetPhysicalDevicePresentationSupport(instance, device, i))
       s->queue_families[i].presentation_support = true;
   }
 
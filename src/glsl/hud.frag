@@ -0,0 +1,31 @@
+#version 460
+
+// Cell coordinates in font pixels, see hud.vert
+layout(location = 0) in vec2 cell;
+layout(location = 1) flat in uint glyph;
+layout(location = 0) out vec4 frag_out;
+
+// 3x5 bitmap font for ' ' (32) to 'Z' (90), one glyph per entry with the
+// top row in the highest three bits and the leftmost pixel in the highest
+// bit of each row. Lower case text is upper cased on the CPU.
+const uint font[59] = uint[59](
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x52a5, 0x0000, 0x0000, 0x2922,
+	0x224a, 0x0000, 0x0000, 0x0000, 0x01c0, 0x0002, 0x12a4, 0x7b6f, 0x2c97,
+	0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, 0x7bef, 0x7bcf, 0x0410,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x2bed, 0x6bae, 0x3923,
+	0x6b6e, 0x79a7, 0x79a4, 0x396b, 0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927,
+	0x5fed, 0x6b6d, 0x2b6a, 0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f,
+	0x5b6a, 0x5bfd, 0x5aad, 0x5a92, 0x72a7);
+
+void main() {
+	const vec4 background = vec4(0.0, 0.0, 0.0, 0.6);
+	ivec2 p = ivec2(cell);
+	if (p.x > 2 || p.y > 4 || glyph >= 59u) {
+		frag_out = background;
+		return;
+	}
+
+	uint row = (font[glyph] >> (3 * (4 - p.y))) & 7u;
+	bool lit = ((row >> (2 - p.x)) & 1u) != 0u;
+	frag_out = lit ? vec4(1.0) : background;
+}
@@ -0,0 +1,27 @@
+#version 460
+
+// One instance per character: its top left corner in pixels and its
+// index into the font of hud.frag
+layout(location = 0) in vec2 origin;
+layout(location = 1) in uint code;
+
+layout(location = 0) out vec2 cell;
+layout(location = 1) flat out uint glyph;
+
+layout(push_constant) uniform parameters {
+	vec2 screen;
+	float scale;
+} p;
+
+// A glyph is 3x5 font pixels in a 4x6 cell, which leaves a gap to the next
+const vec2 cell_size = vec2(4.0, 6.0);
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0),
+	vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+	vec2 corner = corners[gl_VertexIndex];
+	vec2 position = origin + corner * cell_size * p.scale;
+	gl_Position = vec4(position / p.screen * 2.0 - 1.0, 0.0, 1.0);
+	cell = corner * cell_size;
+	glyph = code;
+}
@@ -2,6 +2,9 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
+// The keyframe interpolated towards in a sequence
+layout(location = 2) in vec3 next_position;
+layout(location = 3) in vec4 next_color;
 layout(location = 0) out vec4 frag_in;
 
 layout(set = 0, binding = 0) uniform transformation {
@@ -10,7 +13,43 @@ layout(set = 0, binding = 0) uniform transformation {
 	mat4 projection;
 } m;
 
+// Shader modes, one bit of shader_mode each. Pipelines are built per
+// combination, so the branches below are folded away when compiling.
+layout(constant_id = 0) const bool party_colors = false;
+layout(constant_id = 1) const bool playback_fade = false;
+layout(constant_id = 2) const bool keyframes = false;
+
+layout(push_constant) uniform parameters {
+	uint seed;
+	uint head;
+	uint fade;
+	float t;
+} p;
+
+// Integer hash with good avalanche, see "Hash Functions for GPU Rendering"
+uint hash(uint x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
 void main() {
-	gl_Position = m.projection * m.view * m.model * vec4(position, 1.0);
-	frag_in = color;
+	vec3 at = keyframes ? mix(position, next_position, p.t) : position;
+	gl_Position = m.projection * m.view * m.model * vec4(at, 1.0);
+	if (party_colors) {
+		uint h = hash(uint(gl_VertexIndex) ^ hash(p.seed));
+		frag_in = vec4(uvec3(h, h >> 8, h >> 16) & 255u, 255.0) / 255.0;
+	} else {
+		frag_in = keyframes ? mix(color, next_color, p.t) : color;
+	}
+	// The trail dims with its distance from the head of the playback
+	if (playback_fade) {
+		uint behind = p.head - min(uint(gl_VertexIndex), p.head);
+		frag_in.rgb *= mix(1.0, 0.25, min(float(behind) / float(p.fade), 1.0));
+	}
+	// Only read by the point pipeline, see create_pipeline
+	gl_PointSize = 1.0;
 }
@@ -0,0 +1,371 @@
+#include "sigil.hpp"
+#include <logger.hpp>
+#include <string_view>
+
+bool execute_graph(context *c, VkCommandBuffer cb);
+
+namespace {
+constexpr VkAccessFlags2 write_access =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+// Barriers of one pass, recorded with a single vkCmdPipelineBarrier2
+struct dependencies {
+  std::vector<VkImageMemoryBarrier2> images{};
+  std::vector<VkBufferMemoryBarrier2> buffers{};
+};
+
+bool place_transients(context *c);
+bool create_transient(context *c, graph_transient *t);
+bool find_block(context *c, std::size_t index);
+bool overlaps(const graph_transient &a, const graph_transient &b);
+void retire(frame_graph *g, graph_transient *t);
+void synchronize(graph_resource *r, const graph_use &u, dependencies *d);
+void record_dependencies(VkCommandBuffer cb, dependencies *d);
+} // namespace
+
+// Transients keep their image as long as the name, format and extent
+// stay the same, so their memory is only placed once
+uint32_t frame_graph::transient_image(const char *name,
+                                      const VkImageCreateInfo &info,
+                                      VkImageAspectFlags aspect) {
+  std::size_t i = 0;
+  while (i < transients.size() &&
+         std::string_view{transients[i].name} != name)
+    ++i;
+
+  if (i == transients.size()) {
+    transients.push_back({.name = name, .info = info, .aspect = aspect});
+  } else {
+    auto &t = transients[i];
+    if (t.info.format != info.format ||
+        t.info.extent.width != info.extent.width ||
+        t.info.extent.height != info.extent.height) {
+      retire(this, &t);
+      t.info = info;
+    }
+  }
+
+  resources.push_back({.name = name, .aspect = aspect});
+  resources.back().transient = i;
+  return resources.size() - 1;
+}
+
+uint32_t frame_graph::import_image(const char *name, VkImage image,
+                                   VkImageView view, VkImageAspectFlags aspect,
+                                   const graph_state &before,
+                                   const graph_use &after) {
+  resources.push_back({.name = name, .image = image, .view = view});
+  resources.back().aspect = aspect;
+  resources.back().state = before;
+  resources.back().after = after;
+  return resources.size() - 1;
+}
+
+uint32_t frame_graph::import_buffer(const char *name, VkBuffer buffer,
+                                    const graph_state &before,
+                                    const graph_use &after) {
+  resources.push_back({.name = name, .buffer = buffer});
+  resources.back().state = before;
+  resources.back().after = after;
+  return resources.size() - 1;
+}
+
+void frame_graph::add_pass(const char *name, std::vector<graph_use> uses,
+                           record_t record) {
+  passes.push_back({name, std::move(uses), std::move(record)});
+}
+
+// Records the passes in the order they were added into cb. Before each
+// pass, one barrier covers every resource whose previous use conflicts
+// with this one: writes after reads or writes, reads of a write that is not
+// yet visible to them, and layout changes. Reads of the same data in the
+// same layout are not synchronized again. The graph is emptied afterwards,
+// only the transient images and their memory are kept.
+bool execute_graph(context *c, VkCommandBuffer cb) {
+  auto &g = c->graph;
+  ++g.executions;
+  std::erase_if(g.retired, [&g](const auto &r) {
+    return g.executions - r.first > context::concurrent_frames;
+  });
+
+  if (!place_transients(c))
+    return false;
+
+  for (uint32_t i = 0; i < g.passes.size(); ++i) {
+    const auto &pass = g.passes[i];
+    dependencies d{};
+    for (const auto &u : pass.uses) {
+      auto &r = g.resources[u.resource];
+      // Aliased memory starts out with the hazards of its previous user
+      if (r.transient >= 0 && g.transients[r.transient].first == i) {
+        r.state = g.blocks[g.transients[r.transient].block].state;
+        r.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        r.state.visible_stages = 0;
+        r.state.visible_access = 0;
+      }
+      synchronize(&r, u, &d);
+    }
+    record_dependencies(cb, &d);
+
+    if (pass.record)
+      pass.record(cb, g);
+
+    for (const auto &u : pass.uses) {
+      const auto &r = g.resources[u.resource];
+      if (r.transient >= 0 && g.transients[r.transient].last == i)
+        g.blocks[g.transients[r.transient].block].state = r.state;
+    }
+  }
+
+  dependencies d{};
+  for (auto &r : g.resources)
+    if (r.transient < 0 &&
+        (r.after.stages || r.after.layout != VK_IMAGE_LAYOUT_UNDEFINED))
+      synchronize(&r, r.after, &d);
+  record_dependencies(cb, &d);
+
+  g.resources.clear();
+  g.passes.clear();
+  return true;
+}
+
+namespace {
+// Finds the passes every transient is used in this frame and gives each
+// one memory that no overlapping transient uses
+bool place_transients(context *c) {
+  auto &g = c->graph;
+  for (auto &t : g.transients)
+    t.used = false;
+
+  for (uint32_t i = 0; i < g.passes.size(); ++i)
+    for (const auto &u : g.passes[i].uses) {
+      const auto index = g.resources[u.resource].transient;
+      if (index < 0)
+        continue;
+
+      auto &t = g.transients[index];
+      if (!t.used)
+        t.first = i;
+      t.last = i;
+      t.used = true;
+    }
+
+  // A transient that now overlaps an earlier one in its block moves out
+  for (std::size_t i = 0; i < g.transients.size(); ++i) {
+    auto &t = g.transients[i];
+    if (!t.used)
+      continue;
+
+    for (std::size_t j = 0; j < i && t.block >= 0; ++j)
+      if (g.transients[j].used && g.transients[j].block == t.block &&
+          overlaps(t, g.transients[j]))
+        retire(&g, &t);
+
+    if (t.block < 0 && !find_block(c, i))
+      return false;
+  }
+
+  for (auto &r : g.resources) {
+    if (r.transient < 0)
+      continue;
+    r.image = g.transients[r.transient].image.handle;
+    r.view = g.transients[r.transient].view.handle;
+  }
+  return true;
+}
+
+bool create_transient(context *c, graph_transient *t) {
+  const VkDevice dev = c->device.handle;
+  VkImage image{};
+  if (vkCreateImage(dev, &t->info, nullptr, &image) != VK_SUCCESS)
+    return false;
+
+  t->image = raii::resource<adapter::vk_image>{dev, image};
+  vkGetImageMemoryRequirements(dev, image, &t->requirements);
+  return true;
+}
+
+// Binds transient index to the first block it fits in whose other users
+// this frame are done before it starts or start after it is done. A new
+// block is allocated otherwise; attachments that are never stored try
+// lazily allocated memory first.
+bool find_block(context *c, std::size_t index) {
+  logger l{c->log_level};
+  auto &g = c->graph;
+  auto &t = g.transients[index];
+  const auto a0 = c->allocator.handle;
+
+  if (!t.image.handle && !create_transient(c, &t)) {
+    l.loge("Failed to create transient image: ", t.name, "\n");
+    return false;
+  }
+
+  const auto &req = t.requirements;
+  for (std::size_t b = 0; b < g.blocks.size() && t.block < 0; ++b) {
+    if (g.blocks[b].size < req.size ||
+        !(req.memoryTypeBits & (1u << g.blocks[b].type)))
+      continue;
+
+    bool free{true};
+    for (std::size_t j = 0; j < g.transients.size(); ++j)
+      if (j != index && g.transients[j].used &&
+          g.transients[j].block == int32_t(b) &&
+          overlaps(t, g.transients[j]))
+        free = false;
+    if (free)
+      t.block = b;
+  }
+
+  if (t.block < 0) {
+    VmaAllocationCreateInfo aci{};
+    aci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    aci.memoryTypeBits = req.memoryTypeBits;
+    if (t.info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+      aci.requiredFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    VmaAllocation alloc{};
+    VmaAllocationInfo ai{};
+    auto r = vmaAllocateMemory(a0, &req, &aci, &alloc, &ai);
+    if (r != VK_SUCCESS &&
+        aci.requiredFlags != VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+      aci.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      r = vmaAllocateMemory(a0, &req, &aci, &alloc, &ai);
+    }
+    if (r != VK_SUCCESS) {
+      l.loge("Failed to allocate transient memory with code: ", r, "\n");
+      return false;
+    }
+    vmaSetAllocationName(a0, alloc, "transient");
+
+    graph_block block{.memory = {a0, alloc}, .size = req.size};
+    block.type = ai.memoryType;
+    g.blocks.push_back(std::move(block));
+    t.block = g.blocks.size() - 1;
+    l.logi("Allocated ", req.size >> 10, " KiB of transient memory for ",
+           t.name, "\n");
+  }
+
+  if (vmaBindImageMemory(a0, g.blocks[t.block].memory.handle,
+                         t.image.handle) != VK_SUCCESS) {
+    l.loge("Failed to bind transient image: ", t.name, "\n");
+    return false;
+  }
+
+  VkImageViewCreateInfo vinf{.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  vinf.image = t.image.handle;
+  vinf.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  vinf.format = t.info.format;
+  // Depth attachments are viewed without their stencil
+  vinf.subresourceRange.aspectMask = t.aspect;
+  if (t.aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+    vinf.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  vinf.subresourceRange.levelCount = 1;
+  vinf.subresourceRange.layerCount = 1;
+
+  const VkDevice dev = c->device.handle;
+  VkImageView view{};
+  if (vkCreateImageView(dev, &vinf, nullptr, &view) != VK_SUCCESS) {
+    l.loge("Failed to create transient view: ", t.name, "\n");
+    return false;
+  }
+  t.view = raii::resource<adapter::vk_image_view>{dev, view};
+  return true;
+}
+
+bool overlaps(const graph_transient &a, const graph_transient &b) {
+  return a.first <= b.last && b.first <= a.last;
+}
+
+// An image bound to memory cannot be rebound, so a transient that has to
+// move gets a new one. Frames in flight may still use the old image.
+void retire(frame_graph *g, graph_transient *t) {
+  graph_transient old{.name = t->name};
+  old.image = std::move(t->image);
+  old.view = std::move(t->view);
+  g->retired.emplace_back(g->executions, std::move(old));
+  t->block = -1;
+}
+
+// Adds the barrier u needs after the resource's previous uses, if any
+void synchronize(graph_resource *r, const graph_use &u, dependencies *d) {
+  auto &s = r->state;
+  const bool image = r->image != VK_NULL_HANDLE;
+  const bool relayout = image && u.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                        u.layout != s.layout;
+  const bool write = u.access & write_access;
+
+  VkPipelineStageFlags2 src_stages{};
+  VkAccessFlags2 src_access{};
+  if (write || relayout) {
+    // Layout transitions write the image as well
+    src_stages = s.write_stages | s.read_stages;
+    src_access = s.write_access;
+    s.write_stages = u.stages;
+    s.write_access = u.access & write_access;
+    s.read_stages = write ? 0 : u.stages;
+    s.visible_stages = write ? 0 : u.stages;
+    s.visible_access = write ? 0 : u.access;
+  } else {
+    const bool visible = !(u.stages & ~s.visible_stages) &&
+                         !(u.access & ~s.visible_access);
+    s.read_stages |= u.stages;
+    if (visible || (!s.write_stages && !s.write_access))
+      return;
+
+    src_stages = s.write_stages;
+    src_access = s.write_access;
+    s.visible_stages |= u.stages;
+    s.visible_access |= u.access;
+  }
+
+  if (!src_stages && !src_access && !relayout)
+    return;
+
+  if (image) {
+    VkImageMemoryBarrier2 b{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    b.srcStageMask = src_stages;
+    b.srcAccessMask = src_access;
+    b.dstStageMask = u.stages;
+    b.dstAccessMask = u.access;
+    b.oldLayout = s.layout;
+    b.newLayout = relayout ? u.layout : s.layout;
+    b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = r->image;
+    b.subresourceRange.aspectMask = r->aspect;
+    b.subresourceRange.levelCount = 1;
+    b.subresourceRange.layerCount = 1;
+    d->images.push_back(b);
+    s.layout = b.newLayout;
+    return;
+  }
+
+  VkBufferMemoryBarrier2 b{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+  b.srcStageMask = src_stages;
+  b.srcAccessMask = src_access;
+  b.dstStageMask = u.stages;
+  b.dstAccessMask = u.access;
+  b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.buffer = r->buffer;
+  b.offset = 0;
+  b.size = VK_WHOLE_SIZE;
+  d->buffers.push_back(b);
+}
+
+void record_dependencies(VkCommandBuffer cb, dependencies *d) {
+  if (d->images.empty() && d->buffers.empty())
+    return;
+
+  VkDependencyInfo info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  info.imageMemoryBarrierCount = d->images.size();
+  info.pImageMemoryBarriers = d->images.data();
+  info.bufferMemoryBarrierCount = d->buffers.size();
+  info.pBufferMemoryBarriers = d->buffers.data();
+  vkCmdPipelineBarrier2(cb, &info);
+}
+} // namespace
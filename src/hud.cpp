@@ -0,0 +1,424 @@
+#include "sigil.hpp"
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <hud_fragment_shader.h>
+#include <hud_vertex_shader.h>
+#include <iomanip>
+#include <logger.hpp>
+#include <span>
+#include <sstream>
+
+namespace ch = std::chrono;
+
+bool create_hud(context *c);
+void toggle_hud(context *c);
+void record_hud(context *c, uint32_t frame_index);
+void add_hud_pass(context *c, uint32_t frame_index, uint32_t target);
+uint32_t add_depth_transient(context *c);
+bool create_shader_module(VkDevice dev, std::span<const uint32_t> src,
+                          raii::resource<adapter::vk_shader_module> *mod);
+draw_range visible_range(const context *c);
+
+namespace {
+// Mirrors the push constant block of hud.vert
+struct parameters {
+  float width{};
+  float height{};
+  float scale{};
+};
+
+constexpr std::size_t max_glyphs{256};
+constexpr float scale{3.f}, margin{8.f};
+constexpr float line_height{6.f * scale}, glyph_width{4.f * scale};
+// The text is rebuilt a few times a second, in between only the glyphs of
+// the last refresh are copied
+constexpr ch::milliseconds refresh_interval{250};
+
+bool create_hud_layout(context *c);
+bool create_hud_pipeline(context *c);
+bool create_hud_buffers(context *c);
+void refresh(context *c);
+std::string memory_usage(const context *c);
+void add_line(std::vector<hud_glyph> *glyphs, const std::string &text,
+              std::size_t line);
+} // namespace
+
+// Sets up the overlay: a pipeline that draws one instanced quad per
+// character with the font baked into hud.frag, and a mapped instance
+// buffer per frame. Nothing is drawn until the overlay is toggled on.
+bool create_hud(context *c) {
+  logger l{c->log_level};
+
+  if (!create_hud_layout(c) || !create_hud_pipeline(c)) {
+    l.loge("Failed to create the overlay pipeline\n");
+    return false;
+  }
+
+  if (!create_hud_buffers(c)) {
+    l.loge("Failed to create the overlay buffers\n");
+    return false;
+  }
+
+  return true;
+}
+
+// Shows or hides the overlay. Rates shown right after it appears are
+// measured from this point on.
+void toggle_hud(context *c) {
+  auto &hud = c->hud;
+  hud.visible = !hud.visible;
+  hud.glyphs.clear();
+  hud.refreshed = ch::steady_clock::now();
+  hud.frames = c->frames_rendered;
+  hud.uploaded = c->uploaded_bytes;
+}
+
+// Draws the overlay into the current rendering of the frame's command
+// buffer, see add_scene_pass and add_hud_pass. Costs one draw and a copy of
+// at most a few kilobytes.
+void record_hud(context *c, uint32_t frame_index) {
+  auto &hud = c->hud;
+  if (!hud.visible || !c->hud_pipeline.handle)
+    return;
+
+  if (ch::steady_clock::now() - hud.refreshed >= refresh_interval)
+    refresh(c);
+  if (!hud.glyphs.size())
+    return;
+
+  // The memory need not be host coherent
+  const auto &frame = c->per_frame[frame_index];
+  const auto size = hud.glyphs.size() * sizeof(hud_glyph);
+  std::memcpy(frame.hud_mapped, hud.glyphs.data(), size);
+  vmaFlushAllocation(c->allocator.handle, frame.hud_buffer.allocation, 0, size);
+
+  const VkCommandBuffer rb = frame.graphics_buffer;
+  parameters p{.width = float(c->window_width)};
+  p.height = float(c->window_height);
+  p.scale = scale;
+
+  VkDeviceSize offset{0};
+  vkCmdBindPipeline(rb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    c->hud_pipeline.handle);
+  vkCmdPushConstants(rb, c->hud_layout.handle, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(p), &p);
+  vkCmdBindVertexBuffers(rb, 0, 1, &frame.hud_buffer.handle, &offset);
+  vkCmdSetViewport(rb, 0, 1, &c->viewport);
+  vkCmdSetScissor(rb, 0, 1, &c->scissor);
+  vkCmdDraw(rb, 6, hud.glyphs.size(), 0, 0);
+}
+
+// The compute rasterizer blits the path onto target and leaves no scene
+// pass to draw the overlay in, so it gets a pass of its own. The depth
+// attachment is never tested, it only matches the overlay pipeline, but
+// its clear and store are depth writes in both fragment test stages.
+void add_hud_pass(context *c, uint32_t frame_index, uint32_t target) {
+  if (!c->hud.visible || !c->hud_pipeline.handle)
+    return;
+
+  auto &g = c->graph;
+  const auto depth = add_depth_transient(c);
+
+  graph_use color{.resource = target};
+  color.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+  color.access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                 VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+  color.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  graph_use cleared{.resource = depth};
+  cleared.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                   VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+  cleared.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  cleared.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  const auto draw = [c, frame_index, target, depth](VkCommandBuffer rb,
+                                                    const frame_graph &g) {
+    VkRenderingAttachmentInfo color{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+    color.imageView = g.resources[target].view;
+    color.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkRenderingAttachmentInfo depth_attachment{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+    depth_attachment.imageView = g.resources[depth].view;
+    depth_attachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil = {.depth = 1.f, .stencil = 0};
+
+    VkRenderingInfo info{.sType = VK_STRUCTURE_TYPE_RENDERING_INFO};
+    info.renderArea.extent = {c->window_width, c->window_height};
+    info.layerCount = 1;
+    info.colorAttachmentCount = 1;
+    info.pColorAttachments = &color;
+    info.pDepthAttachment = &depth_attachment;
+
+    vkCmdBeginRendering(rb, &info);
+    record_hud(c, frame_index);
+    vkCmdEndRendering(rb);
+  };
+
+  g.add_pass("overlay", {color, cleared}, draw);
+}
+
+namespace {
+bool create_hud_layout(context *c) {
+  const VkDevice dev = c->device.handle;
+
+  VkPushConstantRange range{};
+  range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  range.offset = 0;
+  range.size = sizeof(parameters);
+
+  VkPipelineLayoutCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  info.pushConstantRangeCount = 1;
+  info.pPushConstantRanges = &range;
+
+  VkPipelineLayout handle{};
+  if (vkCreatePipelineLayout(dev, &info, nullptr, &handle) != VK_SUCCESS)
+    return false;
+  c->hud_layout = raii::resource<adapter::vk_pipeline_layout>{dev, handle};
+  return true;
+}
+
+bool create_hud_pipeline(context *c) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+
+  raii::resource<adapter::vk_shader_module> modules[2];
+  if (!create_shader_module(dev, hud_vertex_shader_spv, &modules[0]) ||
+      !create_shader_module(dev, hud_fragment_shader_spv, &modules[1]))
+    return false;
+
+  VkPipelineShaderStageCreateInfo stages[2]{};
+  const VkShaderStageFlagBits types[] = {VK_SHADER_STAGE_VERTEX_BIT,
+                                         VK_SHADER_STAGE_FRAGMENT_BIT};
+  for (std::size_t i = 0; i < 2; ++i) {
+    stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[i].stage = types[i];
+    stages[i].module = modules[i].handle;
+    stages[i].pName = "main";
+  }
+
+  VkVertexInputBindingDescription binding{};
+  binding.binding = 0;
+  binding.stride = sizeof(hud_glyph);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  VkVertexInputAttributeDescription attributes[2]{};
+  attributes[0].location = 0;
+  attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+  attributes[0].offset = 0;
+  attributes[1].location = 1;
+  attributes[1].format = VK_FORMAT_R32_UINT;
+  attributes[1].offset = offsetof(hud_glyph, code);
+
+  VkPipelineVertexInputStateCreateInfo vertex_input{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+  vertex_input.vertexBindingDescriptionCount = 1;
+  vertex_input.pVertexBindingDescriptions = &binding;
+  vertex_input.vertexAttributeDescriptionCount = 2;
+  vertex_input.pVertexAttributeDescriptions = attributes;
+
+  VkPipelineInputAssemblyStateCreateInfo assembly{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+  assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkPipelineViewportStateCreateInfo viewport{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+  viewport.viewportCount = 1;
+  viewport.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.cullMode = VK_CULL_MODE_NONE;
+  rasterizer.lineWidth = 1.f;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  // Drawn last and on top of the path, so the depth buffer is left alone
+  VkPipelineDepthStencilStateCreateInfo depth{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+
+  VkPipelineColorBlendAttachmentState blend_state{};
+  blend_state.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  blend_state.blendEnable = VK_TRUE;
+  blend_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  blend_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  blend_state.colorBlendOp = VK_BLEND_OP_ADD;
+  blend_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blend_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  blend_state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo blend{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+  blend.attachmentCount = 1;
+  blend.pAttachments = &blend_state;
+
+  const VkDynamicState states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                   VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamic{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+  dynamic.dynamicStateCount = 2;
+  dynamic.pDynamicStates = states;
+
+  // Drawn inside the scene pass, so it renders to the same attachments
+  VkPipelineRenderingCreateInfo rendering{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+  rendering.colorAttachmentCount = 1;
+  rendering.pColorAttachmentFormats = &c->surface_format.format;
+  rendering.depthAttachmentFormat = c->depth_format;
+
+  VkGraphicsPipelineCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+  info.pNext = &rendering;
+  info.stageCount = 2;
+  info.pStages = stages;
+  info.pVertexInputState = &vertex_input;
+  info.pInputAssemblyState = &assembly;
+  info.pViewportState = &viewport;
+  info.pRasterizationState = &rasterizer;
+  info.pMultisampleState = &multisampling;
+  info.pDepthStencilState = &depth;
+  info.pColorBlendState = &blend;
+  info.pDynamicState = &dynamic;
+  info.layout = c->hud_layout.handle;
+
+  VkPipeline handle{};
+  auto r = vkCreateGraphicsPipelines(dev, c->pipeline_cache.handle, 1, &info,
+                                     0, &handle);
+  if (r != VK_SUCCESS) {
+    l.loge("Failed to create overlay pipeline with code: ", r, "\n");
+    return false;
+  }
+
+  c->hud_pipeline = raii::resource<adapter::vk_pipeline>{dev, handle};
+  return true;
+}
+
+// Written by the CPU every frame and read once by the GPU, so the buffers
+// stay mapped in host visible memory
+bool create_hud_buffers(context *c) {
+  logger l{c->log_level};
+  const auto a0 = c->allocator.handle;
+
+  VkBufferCreateInfo bi{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bi.size = max_glyphs * sizeof(hud_glyph);
+  bi.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+  VmaAllocationCreateInfo aci{};
+  aci.usage = VMA_MEMORY_USAGE_AUTO;
+  aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+              VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  for (auto &frame : c->per_frame) {
+    VkBuffer buf{};
+    VmaAllocation alloc{};
+    VmaAllocationInfo ai{};
+    if (vmaCreateBuffer(a0, &bi, &aci, &buf, &alloc, &ai) != VK_SUCCESS) {
+      l.loge("Failed to create overlay buffer using VMA\n");
+      return false;
+    }
+    vmaSetAllocationName(a0, alloc, "overlay");
+    frame.hud_buffer = raii::resource<adapter::vma_buffer>{a0, alloc, buf};
+    frame.hud_mapped = ai.pMappedData;
+  }
+
+  return true;
+}
+
+// Rates are averaged over the time since the previous refresh
+void refresh(context *c) {
+  auto &hud = c->hud;
+  const auto now = ch::steady_clock::now();
+  const ch::duration<double> elapsed = now - hud.refreshed;
+  const auto seconds = elapsed.count();
+  const auto frames = c->frames_rendered - hud.frames;
+  const auto uploaded = c->uploaded_bytes - hud.uploaded;
+  hud.refreshed = now;
+  hud.frames = c->frames_rendered;
+  hud.uploaded = c->uploaded_bytes;
+
+  std::ostringstream gpu{};
+  gpu << std::fixed << std::setprecision(2);
+  const auto &g = c->gpu;
+  if (g.samples)
+    gpu << g.frame_ms[(g.next + g.window - 1) % g.window] << " MS";
+  else
+    gpu << "-";
+
+  std::ostringstream out{};
+  out << std::fixed << std::setprecision(1);
+  out << "FPS " << frames / seconds << "\n";
+  out << std::setprecision(2) << "CPU " << hud.cpu_ms << " MS\n";
+  out << "GPU " << gpu.str() << "\n";
+  out << "VERTICES " << c->vertices.size() << "\n";
+  out << "UPLOAD " << uploaded / seconds / (1 << 20) << " MIB/S\n";
+  out << "VMA " << memory_usage(c) << "\n";
+  out << "STYLE " << draw_style_names[std::size_t(c->style)] << "\n";
+  if (c->range.active)
+    out << "RANGE " << c->range.lo << ":" << c->range.hi << " DRAWS "
+        << visible_range(c).count << "\n";
+  if (c->sequence)
+    out << "KEYFRAME " << c->sequence->keyframe << " T "
+        << c->sequence->t << "\n";
+  if (c->playback.active)
+    out << "PLAY " << std::size_t(c->playback.head) << "/"
+        << c->vertices.size() << (c->playback.paused ? " PAUSED" : "")
+        << "\n";
+  // Shown only when the vertex buffer did not fit, see budget.cpp
+  if (c->placement == vertex_placement::host)
+    out << "VERTICES IN HOST MEMORY\n";
+  else if (c->placement == vertex_placement::decimated)
+    out << "VERTICES DECIMATED\n";
+
+  hud.glyphs.clear();
+  std::istringstream lines{out.str()};
+  std::size_t i{};
+  for (std::string line{}; std::getline(lines, line); ++i)
+    add_line(&hud.glyphs, line, i);
+}
+
+// Used and available bytes over all heaps, as VMA sees them
+std::string memory_usage(const context *c) {
+  const VkPhysicalDeviceMemoryProperties *props{};
+  vmaGetMemoryProperties(c->allocator.handle, &props);
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+  vmaGetHeapBudgets(c->allocator.handle, budgets);
+
+  VkDeviceSize usage{}, budget{};
+  for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+    usage += budgets[i].usage;
+    budget += budgets[i].budget;
+  }
+
+  constexpr VkDeviceSize mib = 1 << 20;
+  return std::to_string(usage / mib) + "/" + std::to_string(budget / mib) +
+         " MIB";
+}
+
+void add_line(std::vector<hud_glyph> *glyphs, const std::string &text,
+              std::size_t line) {
+  const float y = margin + line * line_height;
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    if (glyphs->size() == max_glyphs)
+      return;
+
+    const auto ch = std::toupper(static_cast<unsigned char>(text[i]));
+    hud_glyph g{.x = margin + i * glyph_width, .y = y};
+    g.code = ch >= ' ' && ch <= 'Z' ? ch - ' ' : 0;
+    glyphs->push_back(g);
+  }
+}
+} // namespace
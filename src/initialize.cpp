@@ -1,13 +1,38 @@
 #include "sigil.hpp"
 #include <algorithm>
-#include <filesystem>
-#include <fstream>
+#include <chrono>
+#include <fragment_shader.h>
 #include <logger.hpp>
 #include <query.hpp>
-#include <shader.hpp>
+#include <span>
+#include <thread>
+#include <vertex_shader.h>
+
+namespace ch = std::chrono;
 
 bool parse_cli(context *, int argc, char **argv);
-namespace fs = std::filesystem;
+bool parse_range(context *c);
+bool start_sequence(context *c);
+bool create_shader_module(VkDevice dev, std::span<const uint32_t> src,
+                          raii::resource<adapter::vk_shader_module> *mod);
+bool collect_jobs(context *c);
+bool create_compute(context *c);
+bool create_pipeline_cache(context *c);
+bool start_progressive(context *c);
+void save_pipeline_cache(context *c);
+bool create_queries(context *c);
+bool create_hud(context *c);
+bool create_trace(context *c);
+bool calibrate_trace(context *c);
+void add_phase(const context *c, std::vector<phase_time> *phases,
+               const char *name, ch::steady_clock::time_point start,
+               bool worker);
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
 
 namespace {
 bool initialize(context *, int argc, char **argv);
@@ -21,126 +46,281 @@ bool create_window(context *c);
 bool create_surface(context *c);
 bool create_swapchain(context *c);
 bool create_image_views(context *c);
-bool create_depth_images(context *c);
-bool create_render_pass(context *c);
-bool create_framebuffers(context *c);
+bool create_offscreen_targets(context *c);
+bool create_readback_buffers(context *c);
 bool create_descriptor_pool(context *c);
+bool select_formats(context *c);
 bool create_pipeline_layout(context *c);
-bool create_pipeline(context *c);
+bool create_pipeline(context *c, uint32_t modes, VkPrimitiveTopology topology,
+                     raii::resource<adapter::vk_pipeline> *pipeline);
+void build_pipelines(context *c, bool *ok, std::vector<phase_time> *phases);
 bool create_semaphores(context *c);
 bool create_buffers(context *c);
-bool configure_sigil_vertices(context *c);
+void load_vertices(const context *c, std::vector<vertex> *out,
+                   std::vector<vtype> *values, bool *ok,
+                   std::vector<phase_time> *phases);
+void configure_sigil_vertices(context *c, std::vector<vertex> &&vertices,
+                              std::vector<vtype> &&values);
+
+// Runs one step on the calling thread and records how long it took
+template <typename F> bool timed(context *c, const char *name, F &&step) {
+  const auto start = ch::steady_clock::now();
+  const bool ok = step(c);
+  add_phase(c, &c->phases, name, start, false);
+  return ok;
+}
 } // namespace
 
 bool initialize(context *c, int argc, char **argv) {
-  fs::current_path(fs::absolute(fs::path{argv[0]}.parent_path()));
+  c->launch = ch::steady_clock::now();
   logger l{logger::err};
 
-  if (!parse_cli(c, argc, argv)) {
+  const auto cli = [argc, argv](context *ctx) {
+    return parse_cli(ctx, argc, argv);
+  };
+  if (!timed(c, "parse_cli", cli)) {
     l.loge("The command line input is not valid\n");
     return false;
   }
+  if (c->range_text.size() && !parse_range(c)) {
+    l.loge("The range must be given as LO:HI with LO <= HI\n");
+    return false;
+  }
   initialize_dynamic_state(c);
+  if (c->party)
+    c->modes |= party_colors;
+  // Playback animates the window only, images show the whole path
+  c->playback.active = c->play && !c->headless && !c->export_frames &&
+                       !c->software && !c->batch.size() && !c->manifest.size();
+  if (c->playback.active)
+    c->modes |= playback_fade;
+  if (c->sequence_file.size())
+    c->modes |= keyframes;
   l = logger{c->log_level};
+  if (c->stats)
+    c->profile = std::make_unique<frame_stats>();
+  if (c->trace_file.size())
+    create_trace(c);
+
+  if ((c->batch.size() || c->manifest.size()) &&
+      !timed(c, "collect_jobs", collect_jobs)) {
+    l.loge("Failed to collect batch jobs\n");
+    return false;
+  }
 
-  if (!c->matrix_file.size()) {
+  if (!c->matrix_file.size() && !c->jobs.size() && !c->sequence_file.size()) {
     l.loge("A matrix file must be supplied\n");
     return false;
   }
 
-  if (!initialize_glfw(c)) {
+  // Keyframes are interpolated by the vertex shader of the window
+  if (c->sequence_file.size() &&
+      (c->headless || c->software || c->compute || c->progressive ||
+       c->export_frames || c->jobs.size() || !c->keyframe_ms)) {
+    l.loge("A sequence is only shown in the window by the graphics "
+           "pipelines, with a keyframe time above 0\n");
+    return false;
+  }
+
+  if (c->headless && !c->jobs.size() && !c->output_file.size()) {
+    l.loge("An output file must be supplied in headless mode\n");
+    return false;
+  }
+
+  // The software renderer needs nothing but the scene
+  if (c->software) {
+    if (c->export_frames) {
+      l.loge("Exporting is not supported by the software renderer\n");
+      return false;
+    }
+    if (c->jobs.size())
+      return true;
+
+    std::vector<vertex> vertices{};
+    std::vector<vtype> values{};
+    bool loaded{false};
+    load_vertices(c, &vertices, &values, &loaded, &c->phases);
+    if (loaded)
+      configure_sigil_vertices(c, std::move(vertices), std::move(values));
+    return loaded;
+  }
+
+  // The matrix does not depend on any Vulkan object, so it is read and
+  // ordered while the device, targets and pipelines are being created
+  std::vector<vertex> vertices{};
+  std::vector<vtype> values{};
+  std::vector<phase_time> loader_phases{}, compiler_phases{};
+  bool loaded{true};
+  std::jthread loader{};
+  if (c->progressive && !c->headless && !c->jobs.size())
+    start_progressive(c);
+  else if (!c->jobs.size() && !c->sequence_file.size())
+    loader = std::jthread{load_vertices, c, &vertices, &values, &loaded,
+                          &loader_phases};
+
+  if (!c->headless && !timed(c, "initialize_glfw", initialize_glfw)) {
     l.loge("GLFW initialization failed\n");
     return false;
   }
 
-  if (!create_instance(c)) {
+  if (!timed(c, "create_instance", create_instance)) {
     l.loge("Instance creation failed\n");
     return false;
   }
 
-  if (!select_physical(c)) {
+  if (!timed(c, "select_physical", select_physical)) {
     l.loge("Device selection failed\n");
     return false;
   }
 
-  if (!create_device(c)) {
+  if (!timed(c, "create_device", create_device)) {
     l.loge("Device creation failed\n");
     return false;
   }
 
-  if (!create_memory_allocator(c)) {
+  if (!timed(c, "create_memory_allocator", create_memory_allocator)) {
     l.loge("VMA allocator creation failed\n");
     return false;
   }
 
-  if (!create_window(c)) {
-    l.loge("Window creation failed\n");
-    return false;
+  if (!c->headless) {
+    if (!timed(c, "create_window", create_window)) {
+      l.loge("Window creation failed\n");
+      return false;
+    }
+
+    if (!timed(c, "create_surface", create_surface)) {
+      l.loge("Window surface creation failed\n");
+      return false;
+    }
   }
 
-  if (!create_surface(c)) {
-    l.loge("Window surface creation failed\n");
+  if (!timed(c, "select_formats", select_formats)) {
+    l.loge("Format selection failed\n");
     return false;
   }
 
-  if (!create_swapchain(c)) {
-    l.loge("Swapchain creation failed\n");
+  if (!timed(c, "create_descriptor_pool", create_descriptor_pool)) {
+    l.loge("Descriptor creation failed\n");
     return false;
   }
 
-  if (!create_image_views(c)) {
-    l.loge("Image view creation failed\n");
+  if (!timed(c, "create_pipeline_layout", create_pipeline_layout)) {
+    l.loge("Failed to create pipeline layout\n");
     return false;
   }
 
-  if (!create_depth_images(c)) {
-    l.loge("Depth image creation failed\n");
-    return false;
+  // Pipeline compilation only needs the formats and the layout, so it
+  // overlaps with creating the targets below. The two sides write disjoint
+  // members of the context.
+  bool compiled{false};
+  std::jthread compiler{build_pipelines, c, &compiled, &compiler_phases};
+
+  if (c->headless) {
+    if (!timed(c, "create_offscreen_targets", create_offscreen_targets)) {
+      l.loge("Offscreen target creation failed\n");
+      return false;
+    }
+  } else {
+    if (!timed(c, "create_swapchain", create_swapchain)) {
+      l.loge("Swapchain creation failed\n");
+      return false;
+    }
+
+    if (!timed(c, "create_image_views", create_image_views)) {
+      l.loge("Image view creation failed\n");
+      return false;
+    }
+
+    if (c->capture_supported &&
+        !timed(c, "create_readback_buffers", create_readback_buffers)) {
+      l.loge("Capture buffer creation failed\n");
+      return false;
+    }
   }
 
-  if (!create_render_pass(c)) {
-    l.loge("Render pass creation failed\n");
+  if (!timed(c, "create_semaphores", create_semaphores)) {
+    l.loge("Semaphore creation failed\n");
     return false;
   }
 
-  if (!create_framebuffers(c)) {
-    l.loge("Framebuffer creation failed\n");
+  if (!timed(c, "create_buffers", create_buffers)) {
+    l.loge("Command pool and buffer creation failed\n");
     return false;
   }
 
-  if (!create_descriptor_pool(c)) {
-    l.loge("Descriptor creation failed\n");
+  // Tracing and the overlay need the timestamps as well
+  if ((c->gpu_timing || c->trace || !c->headless) &&
+      !timed(c, "create_queries", create_queries)) {
+    l.loge("Query pool creation failed\n");
     return false;
   }
 
-  if (!create_pipeline_layout(c)) {
-    l.loge("Failed to create pipeline layout\n");
+  if (c->trace && !timed(c, "calibrate_trace", calibrate_trace)) {
+    l.loge("GPU timestamp calibration failed\n");
     return false;
   }
 
-  if (!create_pipeline(c)) {
+  auto start = ch::steady_clock::now();
+  compiler.join();
+  add_phase(c, &c->phases, "wait_pipelines", start, false);
+  c->phases.insert(c->phases.end(), compiler_phases.begin(),
+                   compiler_phases.end());
+  if (!compiled) {
     l.loge("Pipeline creation failed\n");
     return false;
   }
 
-  if (!create_semaphores(c)) {
-    l.loge("Semaphore creation failed\n");
+  if (c->compute && !timed(c, "create_compute", create_compute)) {
+    l.loge("Compute rasterizer creation failed\n");
     return false;
   }
 
-  if (!create_buffers(c)) {
-    l.loge("Command pool and buffer creation failed\n");
+  if (!c->headless && !timed(c, "create_hud", create_hud)) {
+    l.loge("Overlay creation failed\n");
     return false;
   }
+  start = ch::steady_clock::now();
+  save_pipeline_cache(c);
+  add_phase(c, &c->phases, "save_pipeline_cache", start, false);
+
+  if (loader.joinable()) {
+    start = ch::steady_clock::now();
+    loader.join();
+    add_phase(c, &c->phases, "wait_matrix", start, false);
+    c->phases.insert(c->phases.end(), loader_phases.begin(),
+                     loader_phases.end());
+    if (!loaded) {
+      l.loge("Failed to configure sigil\n");
+      return false;
+    }
+    configure_sigil_vertices(c, std::move(vertices), std::move(values));
+  }
 
-  if (!configure_sigil_vertices(c)) {
-    l.loge("Failed to configure sigil\n");
+  if (c->sequence_file.size() && !timed(c, "start_sequence", start_sequence)) {
+    l.loge("Failed to start the sequence\n");
     return false;
   }
 
   return true;
 }
 
+// Every shader's SPIR-V is generated into the build tree and linked into
+// the executable as an array, see glsl/CMakeLists.txt
+bool create_shader_module(VkDevice dev, std::span<const uint32_t> src,
+                          raii::resource<adapter::vk_shader_module> *mod) {
+  VkShaderModuleCreateInfo info{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+  info.codeSize = src.size_bytes();
+  info.pCode = src.data();
+
+  VkShaderModule handle{};
+  if (vkCreateShaderModule(dev, &info, nullptr, &handle) != VK_SUCCESS)
+    return false;
+  *mod = raii::resource<adapter::vk_shader_module>{dev, handle};
+  return true;
+}
+
 namespace {
 void initialize_dynamic_state(context *c) {
   c->viewport.width = (float)c->window_width;
@@ -194,8 +374,9 @@ bool create_instance(context *c) {
   info.pApplicationInfo = &c->app_info;
 
   uint32_t xcount{};
-  glfwGetRequiredInstanceExtensions(&xcount);
-  auto data = glfwGetRequiredInstanceExtensions(&xcount);
+  const char **data{};
+  if (!c->headless)
+    data = glfwGetRequiredInstanceExtensions(&xcount);
 
   l.logi("GLFW requested ", std::to_string(xcount), " instance extensions:\n");
   for (std::size_t i = 0; i < xcount; ++i)
@@ -263,7 +444,8 @@ bool select_physical(context *c) {
     specs::vk_device dev_specs{};
     std::size_t score{1};
 
-    auto r = query::device_specs(&dev_specs, c->instance.handle, dev);
+    auto r = query::device_specs(&dev_specs, c->instance.handle, dev,
+                                 !c->headless);
     if (r != common::result::success) {
       l.loge("Querying physical device failed\n");
       return false;
@@ -276,7 +458,16 @@ bool select_physical(context *c) {
         break;
       }
 
-    if (!is_available(&dev_specs.extensions, "VK_KHR_swapchain"))
+    if (!c->headless &&
+        !is_available(&dev_specs.extensions, "VK_KHR_swapchain"))
+      score = 0;
+
+    if (c->compute && !dev_specs.features12.shaderBufferInt64Atomics)
+      score = 0;
+
+    // Frames are recorded through the frame graph, see graph.cpp
+    if (!dev_specs.features13.dynamicRendering ||
+        !dev_specs.features13.synchronization2)
       score = 0;
 
     score *= dev_specs.properties.limits.maxImageDimension2D;
@@ -336,6 +527,8 @@ bool create_device(context *c) {
   logger l{c->log_level};
 
   assign_queue_family_indices(c);
+  if (c->headless)
+    c->presentation_queue_family_index = c->graphics_queue_family_index;
   std::vector<float> prio{1.f};
 
   VkDeviceQueueCreateInfo qinfos[] = {
@@ -359,13 +552,44 @@ bool create_device(context *c) {
     info.queueCreateInfoCount = 1;
   }
 
-  static constexpr const char *swpx = "VK_KHR_swapchain";
-  info.ppEnabledExtensionNames = &swpx;
-  info.enabledExtensionCount = 1;
+  // The budget extension lets VMA report what the driver actually grants
+  // this process instead of the heap sizes
+  std::vector<const char *> extensions{};
+  if (!c->headless)
+    extensions.push_back("VK_KHR_swapchain");
+  c->memory_budget = is_available(&c->device_capabilities.extensions,
+                                  VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (c->memory_budget)
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  info.ppEnabledExtensionNames = extensions.data();
+  info.enabledExtensionCount = extensions.size();
   VkPhysicalDeviceFeatures features{};
   features.depthClamp = VK_TRUE;
+  features.pipelineStatisticsQuery =
+      c->gpu_timing && c->device_capabilities.features.pipelineStatisticsQuery;
   info.pEnabledFeatures = &features;
 
+  // The compute rasterizer packs depth and color into 64 bit atomics
+  VkPhysicalDeviceVulkan12Features features12{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  if (c->compute) {
+    const auto &caps = c->device_capabilities;
+    if (!caps.features.shaderInt64 ||
+        !caps.features12.shaderBufferInt64Atomics) {
+      l.loge("The device does not support 64 bit buffer atomics\n");
+      return false;
+    }
+    features.shaderInt64 = VK_TRUE;
+    features12.shaderBufferInt64Atomics = VK_TRUE;
+  }
+
+  VkPhysicalDeviceVulkan13Features features13{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+  features13.dynamicRendering = VK_TRUE;
+  features13.synchronization2 = VK_TRUE;
+  features13.pNext = c->compute ? &features12 : nullptr;
+  info.pNext = &features13;
+
   VkDevice handle{VK_NULL_HANDLE};
   auto r = vkCreateDevice(c->selected_device, &info, 0, &handle);
   if (r != VK_SUCCESS) {
@@ -389,6 +613,8 @@ bool create_memory_allocator(context *c) {
   info.physicalDevice = c->selected_device;
   info.instance = c->instance.handle;
   info.device = c->device.handle;
+  if (c->memory_budget)
+    info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
   VmaAllocator handle{};
   if (vmaCreateAllocator(&info, &handle) != VK_SUCCESS)
@@ -475,9 +701,6 @@ bool select_surface_format(context *c) {
 bool create_swapchain(context *c) {
   auto image_count = select_image_count(c);
   logger l{c->log_level};
-
-  if (!select_surface_format(c))
-    return false;
   auto format = c->surface_format;
 
   VkExtent2D size{.width = c->window_width, .height = c->window_height};
@@ -494,6 +717,13 @@ bool create_swapchain(context *c) {
     return false;
   }
 
+  // Captures copy the presented image out, see capture.cpp
+  c->capture_supported =
+      c->surface_capabilities.capabilities.supportedUsageFlags &
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  if (c->capture_supported)
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
   auto transform = c->surface_capabilities.capabilities.currentTransform;
   if (c->surface_capabilities.capabilities.supportedTransforms &
       VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
@@ -580,69 +810,43 @@ bool create_image_views(context *c) {
   return true;
 }
 
-bool find_supported_format(const std::vector<VkFormat> &candidates,
-                           const VkPhysicalDevice dev, VkImageTiling tiling,
-                           VkFormatFeatureFlags features, VkFormat *out) {
-
-  for (VkFormat format : candidates) {
-    VkFormatProperties props;
-    vkGetPhysicalDeviceFormatProperties(dev, format, &props);
-
-    if (tiling == VK_IMAGE_TILING_LINEAR &&
-        (props.linearTilingFeatures & features) == features) {
-      *out = format;
-      return true;
-    } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
-               (props.optimalTilingFeatures & features) == features) {
-      *out = format;
-      return true;
-    }
-  }
-
-  return false;
-}
-
-bool create_depth_images(context *c) {
+bool create_offscreen_targets(context *c) {
   logger l{c->log_level};
-  if (!find_supported_format(
-          {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
-           VK_FORMAT_D24_UNORM_S8_UINT},
-          c->selected_device, VK_IMAGE_TILING_OPTIMAL,
-          VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT, &c->depth_format)) {
-    l.loge("Failed to find depth attachment format!\n");
-    return false;
-  }
 
   VkImageCreateInfo info{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
   info.imageType = VK_IMAGE_TYPE_2D;
   info.arrayLayers = 1;
   info.extent = {c->window_width, c->window_height, 1};
-  info.format = c->depth_format;
+  info.format = c->surface_format.format;
   info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   info.mipLevels = 1;
   info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+               VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT;
   info.samples = VK_SAMPLE_COUNT_1_BIT;
 
   VkImageViewCreateInfo vinf{.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
   vinf.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  vinf.format = c->depth_format;
+  vinf.format = c->surface_format.format;
   vinf.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
   vinf.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
   vinf.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
   vinf.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-  vinf.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  vinf.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   vinf.subresourceRange.baseArrayLayer = 0;
   vinf.subresourceRange.baseMipLevel = 0;
   vinf.subresourceRange.layerCount = 1;
   vinf.subresourceRange.levelCount = 1;
 
-  c->depth_images.resize(c->images.size());
-  c->depth_views.resize(c->images.size());
+  // One target per frame slot, so that consecutive offscreen frames
+  // can be in flight at the same time.
+  c->color_images.resize(c->concurrent_frames);
+  c->image_views.resize(c->concurrent_frames);
   const auto a0 = c->allocator.handle;
   const VkDevice dev = c->device.handle;
 
-  for (std::size_t i = 0; i < c->depth_images.size(); ++i) {
+  for (std::size_t i = 0; i < c->concurrent_frames; ++i) {
     VmaAllocationCreateInfo aci{};
     aci.usage = VMA_MEMORY_USAGE_AUTO;
     aci.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
@@ -652,117 +856,94 @@ bool create_depth_images(context *c) {
     VkImageView img_view{};
     VkImage img{};
     if (vmaCreateImage(a0, &info, &aci, &img, &alloc, 0) != VK_SUCCESS) {
-      l.loge("Failed to create depth image\n");
+      l.loge("Failed to create offscreen color image\n");
       return false;
     }
-    c->depth_images[i] = raii::resource<adapter::vma_image>{a0, alloc, img};
+    vmaSetAllocationName(a0, alloc, "color");
+    c->color_images[i] = raii::resource<adapter::vma_image>{a0, alloc, img};
 
-    vinf.image = c->depth_images[i].handle;
-    auto r = vkCreateImageView(dev, &vinf, nullptr, &img_view);
-    if (r != VK_SUCCESS) {
-      l.loge("Failed to create depth view\n");
+    vinf.image = img;
+    if (vkCreateImageView(dev, &vinf, nullptr, &img_view) != VK_SUCCESS) {
+      l.loge("Failed to create offscreen color view\n");
       return false;
     }
-    c->depth_views[i] = raii::resource<adapter::vk_image_view>{dev, img_view};
+    c->image_views[i] = raii::resource<adapter::vk_image_view>{dev, img_view};
   }
 
-  return true;
+  return create_readback_buffers(c);
 }
 
-bool create_framebuffers(context *c) {
-  c->framebuffers.resize(c->images.size());
-  const VkDevice dev = c->device.handle;
+bool create_readback_buffers(context *c) {
   logger l{c->log_level};
+  const auto a0 = c->allocator.handle;
 
-  VkFramebufferCreateInfo info{.sType =
-                                   VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-  info.renderPass = c->render_pass.handle;
-  info.width = c->window_width;
-  info.height = c->window_height;
-  info.layers = 1;
-
-  for (std::size_t i = 0; i < c->images.size(); ++i) {
-    VkImageView attachments[] = {c->image_views[i].handle,
-                                 c->depth_views[i].handle};
+  VkBufferCreateInfo rb{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  rb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  rb.size = VkDeviceSize{c->window_width} * c->window_height * 4;
+  rb.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-    info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-    info.pAttachments = attachments;
-    VkFramebuffer handle{};
+  // Random host access makes VMA prefer HOST_CACHED memory, which is
+  // what a CPU read of the whole image wants.
+  VmaAllocationCreateInfo bci{};
+  bci.usage = VMA_MEMORY_USAGE_AUTO;
+  bci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
 
-    auto r = vkCreateFramebuffer(dev, &info, nullptr, &handle);
-    if (r != VK_SUCCESS) {
-      l.loge("Failed to create framebuffer\n");
+  for (std::size_t i = 0; i < c->concurrent_frames; ++i) {
+    VmaAllocation alloc{};
+    VkBuffer buf{};
+    if (vmaCreateBuffer(a0, &rb, &bci, &buf, &alloc, 0) != VK_SUCCESS) {
+      l.loge("Failed to create readback buffer using VMA\n");
       return false;
     }
-    c->framebuffers[i] = raii::resource<adapter::vk_framebuffer>{dev, handle};
+    vmaSetAllocationName(a0, alloc, "readback");
+    c->per_frame[i].readback_buffer =
+        raii::resource<adapter::vma_buffer>{a0, alloc, buf};
   }
 
   return true;
 }
 
-bool create_render_pass(context *c) {
-  VkAttachmentDescription attachment{};
-  attachment.format = c->surface_format.format;
-  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentDescription depth{};
-  depth.format = c->depth_format;
-  depth.samples = VK_SAMPLE_COUNT_1_BIT;
-  depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentReference attachment_ref{};
-  attachment_ref.attachment = 0;
-  attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentReference depth_ref{};
-  depth_ref.attachment = 1;
-  depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass{};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &attachment_ref;
-  subpass.pDepthStencilAttachment = &depth_ref;
-
-  VkSubpassDependency dependency{};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.srcAccessMask = 0;
-
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  VkAttachmentDescription descs[] = {attachment, depth};
-  info.attachmentCount = sizeof(descs) / sizeof(descs[0]);
-  info.pAttachments = descs;
-  info.subpassCount = 1;
-  info.pSubpasses = &subpass;
-  info.dependencyCount = 1;
-  info.pDependencies = &dependency;
-
-  const auto device = c->device.handle;
-  VkRenderPass handle{};
-  if (vkCreateRenderPass(device, &info, nullptr, &handle) != VK_SUCCESS)
+bool find_supported_format(const std::vector<VkFormat> &candidates,
+                           const VkPhysicalDevice dev, VkImageTiling tiling,
+                           VkFormatFeatureFlags features, VkFormat *out) {
+
+  for (VkFormat format : candidates) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(dev, format, &props);
+
+    if (tiling == VK_IMAGE_TILING_LINEAR &&
+        (props.linearTilingFeatures & features) == features) {
+      *out = format;
+      return true;
+    } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
+               (props.optimalTilingFeatures & features) == features) {
+      *out = format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Pipelines only need the formats, so they are picked before any target
+// exists
+bool select_formats(context *c) {
+  logger l{c->log_level};
+  if (c->headless) {
+    c->surface_format.format = VK_FORMAT_R8G8B8A8_UNORM;
+    c->surface_format.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+  } else if (!select_surface_format(c))
+    return false;
+
+  if (!find_supported_format(
+          {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+           VK_FORMAT_D24_UNORM_S8_UINT},
+          c->selected_device, VK_IMAGE_TILING_OPTIMAL,
+          VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT, &c->depth_format)) {
+    l.loge("Failed to find depth attachment format!\n");
     return false;
+  }
 
-  c->render_pass = raii::resource<adapter::vk_render_pass>{device, handle};
   return true;
 }
 
@@ -820,8 +1001,13 @@ bool create_pipeline_layout(context *c) {
   info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   info.setLayoutCount = 1;
   info.pSetLayouts = &c->desc_layout.handle;
-  info.pushConstantRangeCount = 0;
-  info.pPushConstantRanges = nullptr;
+  // See vertex_parameters
+  VkPushConstantRange range{};
+  range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  range.offset = 0;
+  range.size = sizeof(vertex_parameters);
+  info.pushConstantRangeCount = 1;
+  info.pPushConstantRanges = &range;
 
   if (vkCreatePipelineLayout(dev, &info, nullptr, &handle) != VK_SUCCESS)
     return false;
@@ -848,36 +1034,39 @@ bool create_pipeline_layout(context *c) {
   return true;
 }
 
+// Two vertex streams of the same layout, the second at locations 2 and 3
+// holds the next keyframe of a sequence, see shader.vert. Every pipeline
+// reads both, outside of a sequence the same buffer is bound twice.
 bool conf_vertex_input_info(VkPipelineVertexInputStateCreateInfo *info,
                             VkVertexInputBindingDescription *binding_desc,
-                            const vertex::attr_desc_t *attrib_desc) {
-
-  binding_desc->binding = 0;
-  binding_desc->stride = sizeof(vertex);
-  binding_desc->inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+                            VkVertexInputAttributeDescription *attrib_desc) {
+  const auto desc = vertex::attribute_description();
+  for (uint32_t i = 0; i < 2; ++i) {
+    binding_desc[i].binding = i;
+    binding_desc[i].stride = sizeof(vertex);
+    binding_desc[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    for (std::size_t j = 0; j < desc.size(); ++j) {
+      auto &a = attrib_desc[i * desc.size() + j];
+      a = desc[j];
+      a.binding = i;
+      a.location += i * desc.size();
+    }
+  }
 
   info->sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  info->vertexBindingDescriptionCount = 1;
+  info->vertexBindingDescriptionCount = 2;
   info->pVertexBindingDescriptions = binding_desc;
-  info->vertexAttributeDescriptionCount = attrib_desc->size();
-  info->pVertexAttributeDescriptions = attrib_desc->data();
+  info->vertexAttributeDescriptionCount = 2 * desc.size();
+  info->pVertexAttributeDescriptions = attrib_desc;
   return true;
 }
 
-bool conf_shader(const VkDevice dev, std::vector<uint32_t> *src,
+bool conf_shader(const VkDevice dev, std::span<const uint32_t> src,
                  VkPipelineShaderStageCreateInfo *info, auto *mod,
                  VkShaderStageFlagBits type) {
-
-  VkShaderModuleCreateInfo inf{};
-  inf.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  inf.codeSize = src->size() * sizeof(uint32_t);
-  inf.pCode = src->data();
-
-  VkShaderModule handle{};
-  auto r = vkCreateShaderModule(dev, &inf, nullptr, &handle);
-  if (r != VK_SUCCESS)
+  if (!create_shader_module(dev, src, mod))
     return false;
-  *mod = raii::resource<adapter::vk_shader_module>{dev, handle};
 
   info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   info->stage = type;
@@ -887,33 +1076,23 @@ bool conf_shader(const VkDevice dev, std::vector<uint32_t> *src,
   return true;
 }
 
+// spec specializes the vertex shader, see shader_mode
 bool conf_shaders(const VkDevice dev, VkPipelineShaderStageCreateInfo *info,
-                  auto *mod, std::size_t log_level) {
+                  auto *mod, const VkSpecializationInfo *spec,
+                  std::size_t log_level) {
   logger l{log_level};
 
   *info = {};
   *(info + 1) = {};
 
-  std::vector<uint32_t> vert_src{};
-  auto r = shader::read_spirv("./vertex_shader.spv", &vert_src);
-  if (r != common::result::success) {
-    l.loge("Failed to read shader source file\n");
-    return false;
-  }
-
-  std::vector<uint32_t> frag_src{};
-  r = shader::read_spirv("./fragment_shader.spv", &frag_src);
-  if (r != common::result::success) {
-    l.loge("Failed to read shader source file\n");
-    return false;
-  }
-
-  if (!conf_shader(dev, &vert_src, info, mod, VK_SHADER_STAGE_VERTEX_BIT)) {
+  if (!conf_shader(dev, vertex_shader_spv, info, mod,
+                   VK_SHADER_STAGE_VERTEX_BIT)) {
     l.loge("Failed to create vertex shader module\n");
     return false;
   }
+  info->pSpecializationInfo = spec;
 
-  if (!conf_shader(dev, &frag_src, (info + 1), (mod + 1),
+  if (!conf_shader(dev, fragment_shader_spv, (info + 1), (mod + 1),
                    VK_SHADER_STAGE_FRAGMENT_BIT)) {
     l.loge("Failed to create fragment shader module\n");
     return false;
@@ -928,9 +1107,12 @@ bool conf_dynamic_state(VkPipelineDynamicStateCreateInfo *info,
                         VkViewport *viewport, VkRect2D *scissor, uint32_t width,
                         uint32_t height) {
 
-  states->resize(2);
-  (*states)[0] = VK_DYNAMIC_STATE_VIEWPORT;
-  (*states)[1] = VK_DYNAMIC_STATE_SCISSOR;
+  // Core in Vulkan 1.3: the draw style is switched without a rebuild,
+  // see add_scene_pass
+  *states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+             VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+             VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+             VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE};
 
   info->sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
   info->dynamicStateCount = static_cast<uint32_t>(states->size());
@@ -956,9 +1138,10 @@ bool conf_dynamic_state(VkPipelineDynamicStateCreateInfo *info,
 
 bool conf_assembly(VkPipelineInputAssemblyStateCreateInfo *a,
                    VkPipelineRasterizationStateCreateInfo *r,
-                   VkPipelineMultisampleStateCreateInfo *m) {
+                   VkPipelineMultisampleStateCreateInfo *m,
+                   VkPrimitiveTopology topology) {
   a->sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  a->topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+  a->topology = topology;
   a->primitiveRestartEnable = VK_FALSE;
 
   r->sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -1003,12 +1186,31 @@ bool conf_color(VkPipelineColorBlendAttachmentState *state,
   return true;
 }
 
-bool create_pipeline(context *c) {
+// The topology only picks the topology class, the exact topology is set
+// when drawing. The shader_mode bits in modes become the vertex shader's
+// specialization constants, in the order of the bits.
+bool create_pipeline(context *c, uint32_t modes, VkPrimitiveTopology topology,
+                     raii::resource<adapter::vk_pipeline> *pipeline) {
   logger l{c->log_level};
 
+  std::array<VkBool32, shader_mode_count> constants{};
+  std::array<VkSpecializationMapEntry, shader_mode_count> entries{};
+  for (uint32_t i = 0; i < shader_mode_count; ++i) {
+    constants[i] = (modes >> i) & 1;
+    entries[i].constantID = i;
+    entries[i].offset = i * sizeof(VkBool32);
+    entries[i].size = sizeof(VkBool32);
+  }
+  VkSpecializationInfo spec{};
+  spec.mapEntryCount = entries.size();
+  spec.pMapEntries = entries.data();
+  spec.dataSize = sizeof(constants);
+  spec.pData = constants.data();
+
   raii::resource<adapter::vk_shader_module> modules[2];
   VkPipelineShaderStageCreateInfo shader_stages[2];
-  if (!conf_shaders(c->device.handle, shader_stages, modules, c->log_level))
+  if (!conf_shaders(c->device.handle, shader_stages, modules, &spec,
+                    c->log_level))
     return false;
 
   VkPipelineViewportStateCreateInfo viewport_state{};
@@ -1020,14 +1222,14 @@ bool create_pipeline(context *c) {
                      &viewport, &scissor, c->window_width, c->window_height);
 
   VkPipelineVertexInputStateCreateInfo vertex_input{};
-  auto attrib_desc = vertex::attribute_description();
-  VkVertexInputBindingDescription vbd{};
-  conf_vertex_input_info(&vertex_input, &vbd, &attrib_desc);
+  VkVertexInputAttributeDescription attrib_desc[4]{};
+  VkVertexInputBindingDescription vbd[2]{};
+  conf_vertex_input_info(&vertex_input, vbd, attrib_desc);
 
   VkPipelineInputAssemblyStateCreateInfo input_assembly{};
   VkPipelineRasterizationStateCreateInfo rasterizer{};
   VkPipelineMultisampleStateCreateInfo multisampling{};
-  conf_assembly(&input_assembly, &rasterizer, &multisampling);
+  conf_assembly(&input_assembly, &rasterizer, &multisampling, topology);
 
   VkPipelineColorBlendAttachmentState color_attachment{};
   VkPipelineColorBlendStateCreateInfo color_blending{};
@@ -1039,14 +1241,21 @@ bool create_pipeline(context *c) {
   depth.depthWriteEnable = VK_TRUE;
   depth.depthCompareOp = VK_COMPARE_OP_LESS;
 
+  // Dynamic rendering: the pipeline is built against attachment formats
+  // instead of a render pass
+  VkPipelineRenderingCreateInfo rendering{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+  rendering.colorAttachmentCount = 1;
+  rendering.pColorAttachmentFormats = &c->surface_format.format;
+  rendering.depthAttachmentFormat = c->depth_format;
+
   VkGraphicsPipelineCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  info.pNext = &rendering;
   info.stageCount = sizeof(shader_stages) / sizeof(shader_stages[0]);
   info.pStages = shader_stages;
   info.pRasterizationState = &rasterizer;
   info.pVertexInputState = &vertex_input;
-  info.renderPass = c->render_pass.handle;
-  info.subpass = 0;
   info.layout = c->layout.handle;
   info.pViewportState = &viewport_state;
   info.pInputAssemblyState = &input_assembly;
@@ -1056,16 +1265,66 @@ bool create_pipeline(context *c) {
   info.pDepthStencilState = &depth;
 
   VkPipeline handle{};
-  auto r = vkCreateGraphicsPipelines(c->device.handle, 0, 1, &info, 0, &handle);
+  auto r = vkCreateGraphicsPipelines(c->device.handle, c->pipeline_cache.handle,
+                                     1, &info, 0, &handle);
   if (r != VK_SUCCESS) {
     l.loge("Failed to create pipeline with code: " + std::to_string(r), "\n");
     return false;
   }
 
-  c->pipeline = raii::resource<adapter::vk_pipeline>{c->device.handle, handle};
+  *pipeline = raii::resource<adapter::vk_pipeline>{c->device.handle, handle};
   return true;
 }
 
+// Runs on a worker thread during initialize, see there
+void build_pipelines(context *c, bool *ok, std::vector<phase_time> *phases) {
+  if (c->trace)
+    c->trace->name_thread("compiler");
+
+  auto start = ch::steady_clock::now();
+  *ok = create_pipeline_cache(c);
+  add_phase(c, phases, "create_pipeline_cache", start, true);
+  if (!*ok)
+    return;
+
+  // One worker per topology class, so switching styles never compiles at
+  // runtime. The shader modes are fixed by the command line, so only their
+  // combination is built; c->pipelines caches variants by mode bits. The
+  // pipeline cache is internally synchronized and every worker writes its
+  // own pipeline.
+  struct variant_job {
+    uint32_t modes{};
+    VkPrimitiveTopology topology{};
+    const char *name{};
+    raii::resource<adapter::vk_pipeline> *pipeline{};
+    bool ok{false};
+    std::vector<phase_time> phases{};
+  };
+  std::vector<variant_job> jobs{};
+  auto &v = c->pipelines[c->modes];
+  jobs.push_back({c->modes, VK_PRIMITIVE_TOPOLOGY_LINE_STRIP,
+                  "create_pipeline", &v.lines});
+  jobs.push_back({c->modes, VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+                  "create_point_pipeline", &v.points});
+
+  {
+    std::vector<std::jthread> workers{};
+    for (auto &j : jobs)
+      workers.emplace_back([c, &j] {
+        if (c->trace)
+          c->trace->name_thread("compiler");
+        const auto start = ch::steady_clock::now();
+        j.ok = create_pipeline(c, j.modes, j.topology, j.pipeline);
+        add_phase(c, &j.phases, j.name, start, true);
+      });
+  }
+
+  for (const auto &j : jobs) {
+    phases->insert(phases->end(), j.phases.begin(), j.phases.end());
+    *ok = *ok && j.ok;
+  }
+}
+
 bool create_semaphore(VkSemaphore *handle, const VkDevice device) {
   logger l{logger::err};
 
@@ -1194,110 +1453,43 @@ bool create_buffers(context *c) {
       l.loge("Failed to create descriptor buffer using VMA\n");
       return false;
     }
+    vmaSetAllocationName(a0, alloc, "uniforms");
     c->per_frame[i].desc_buffer =
         raii::resource<adapter::vma_buffer>{a0, alloc, handle};
   }
   return true;
 }
 
-using vtype = int;
-
-bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d) {
-  if (!d)
-    return false;
-
-  std::ifstream stream{path};
-  if (!stream.is_open())
-    return false;
-
-  std::vector<vtype> linear{};
-  vtype entry{};
-  while (true) {
-    stream >> entry;
-    if (stream.eof() || stream.bad())
-      break;
-    linear.push_back(entry);
-  }
-
-  if (stream.bad())
-    return false;
-
-  const double root = std::sqrt(linear.size());
-  const std::size_t trunc = root;
-  if (trunc * trunc != linear.size())
-    return false; // matrix is not square
-
-  d->resize(trunc);
-  for (std::size_t i = 0; i < d->size(); ++i)
-    (*d)[i].resize(trunc);
-
-  std::size_t row{}, col{};
-  for (std::size_t i = 0; i < linear.size(); ++i) {
-    (*d)[row][col++] = linear[i];
-    if (col == trunc) {
-      col = 0;
-      ++row;
-    }
-  }
-  return true;
-}
-
-std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
-                                     bool compress, float r, float g, float b) {
-  std::vector<vertex> out{};
-
-  struct sort_info {
-    std::size_t row, col;
-    vtype val;
-  };
-
-  std::vector<sort_info> ordered{};
-  for (std::size_t i = 0; i < m.size(); ++i)
-    for (std::size_t j = 0; j < m[i].size(); ++j)
-      ordered.push_back({i, j, m[i][j]});
-
-  auto ascend = [](const auto &a, const auto &b) { return a.val < b.val; };
-  std::sort(ordered.begin(), ordered.end(), ascend);
-
-  const auto side = std::sqrt(ordered.size());
-  const auto sz = double(side);
-
-  double depth_max{};
-  for (const auto &e : ordered)
-    if (e.val > depth_max)
-      depth_max = e.val;
-
-  for (auto &&e : ordered) {
-    const auto x = e.col / sz - (1.f - e.col / sz) / 2.f;
-    const auto y = e.row / sz - (1.f - e.row / sz) / 2.f;
-    out.push_back(
-        {.position = {x, y, compress ? 0 : e.val / (depth_max / 4.f) - 3.5f},
-         .color = {r, g, b, 1.f}});
-  }
-  return out;
-}
-
-bool configure_sigil_vertices(context *c) {
+// Runs on a worker thread during initialize and must not touch the context
+// beyond reading the options
+void load_vertices(const context *c, std::vector<vertex> *out,
+                   std::vector<vtype> *values, bool *ok,
+                   std::vector<phase_time> *phases) {
   logger l{c->log_level};
+  if (c->trace)
+    c->trace->name_thread("loader");
+
   std::vector<std::vector<vtype>> data{};
-  if (!read_matrix(c->matrix_file, &data)) {
+  auto start = ch::steady_clock::now();
+  *ok = read_matrix(c->matrix_file, &data);
+  add_phase(c, phases, "read_matrix", start, true);
+  if (!*ok) {
     l.loge("Failed to read matrix from source file\n");
-    return false;
+    return;
   }
 
-  c->vertices = normalize_matrix(data, c->compress, c->red, c->green, c->blue);
-  c->update_buffers = true;
-
-  const auto center = glm::vec3(0.f, 0.f, 0.f);
-  const auto eye = glm::vec3(0.f, 0.f, 30.f);
-  const auto up = glm::vec3(0.f, 1.f, 0.f);
-  c->matrices.view = glm::lookAt(eye, center, up);
-
-  const auto aspect = float(c->window_width) / float(c->window_height);
-  const float far = 10 * c->vertices.size();
-  const auto near = 0.1f;
-  c->matrices.projection = glm::perspective(220.f, aspect, near, far);
+  start = ch::steady_clock::now();
+  *out =
+      normalize_matrix(data, c->compress, c->red, c->green, c->blue, values);
+  add_phase(c, phases, "normalize_matrix", start, true);
+}
 
-  return true;
+void configure_sigil_vertices(context *c, std::vector<vertex> &&vertices,
+                              std::vector<vtype> &&values) {
+  c->vertices = std::move(vertices);
+  c->values = std::move(values);
+  c->matrices = make_transformation(c->window_width, c->window_height,
+                                    c->vertices.size());
+  c->update_buffers = true;
 }
 } // namespace
@@ -8,6 +8,25 @@ namespace ch = std::chrono;
 bool initialize(context *, int argc, char **argv);
 bool render(context *c);
 bool update(context *c);
+bool render_offscreen(context *c);
+bool run_batch(context *c);
+bool run_export(context *c);
+bool render_software(context *c);
+void report_startup(context *c, bool first_frame);
+void report_queries(context *c);
+void report_stats(context *c);
+void write_trace(context *c);
+void report_memory(context *c);
+
+namespace {
+// Reports gathered while running, once the work of a mode is done
+void finish(context *c) {
+  report_queries(c);
+  report_stats(c);
+  write_trace(c);
+  report_memory(c);
+}
+} // namespace
 
 int main(int argc, char **argv) {
   logger l{logger::err};
@@ -18,8 +37,56 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (ctx.software) {
+    report_startup(&ctx, false);
+    if (!render_software(&ctx)) {
+      l.loge("Software rendering failed\n");
+      return 2;
+    }
+    finish(&ctx);
+    return 0;
+  }
+
+  if (ctx.jobs.size()) {
+    report_startup(&ctx, false);
+    if (!run_batch(&ctx)) {
+      l.loge("Batch rendering failed\n");
+      return 2;
+    }
+    finish(&ctx);
+    return 0;
+  }
+
+  if (ctx.headless) {
+    if (!update(&ctx)) {
+      l.loge("Updating failed\n");
+      return 1;
+    }
+
+    if (ctx.export_frames) {
+      report_startup(&ctx, false);
+      if (!run_export(&ctx)) {
+        l.loge("Exporting failed\n");
+        return 2;
+      }
+      finish(&ctx);
+      return 0;
+    }
+
+    if (!render_offscreen(&ctx)) {
+      l.loge("Offscreen rendering failed\n");
+      return 2;
+    }
+    report_startup(&ctx, true);
+    finish(&ctx);
+    return 0;
+  }
+
   constexpr ch::milliseconds time_per_frame{std::size_t((1.0 / 60.0) * 1000)};
+  constexpr std::size_t stats_interval{600};
+  const auto profile = ctx.profile.get();
   auto frame_start = ch::steady_clock::now();
+  auto frame_end = frame_start;
 
   while (glfwWindowShouldClose(ctx.window.handle) != GLFW_TRUE) {
     auto now = ch::steady_clock::now();
@@ -31,7 +98,16 @@ int main(int argc, char **argv) {
       continue;
     }
 
-    glfwPollEvents();
+    // Everything between two frames counts as sleep, not each 100 us nap
+    if (profile)
+      profile->add(frame_phase::sleep, now - frame_end);
+    if (ctx.trace)
+      ctx.trace->span("sleep", frame_end, now);
+
+    {
+      scoped_timer timer{&ctx, frame_phase::poll};
+      glfwPollEvents();
+    }
 
     if (!update(&ctx)) {
       l.loge("Updating failed\n");
@@ -42,5 +118,12 @@ int main(int argc, char **argv) {
       l.loge("Rendering failed\n");
       return 2;
     }
+
+    frame_end = ch::steady_clock::now();
+    ctx.hud.cpu_ms = ch::duration<double, std::milli>(frame_end - now).count();
+    if (profile && ++profile->frames % stats_interval == 0)
+      report_stats(&ctx);
   }
+
+  finish(&ctx);
 }
@@ -0,0 +1,150 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+bool read_matrix_frame(std::istream *in, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
+
+namespace {
+bool fold_square(const std::vector<vtype> &linear,
+                 std::vector<std::vector<vtype>> *d);
+} // namespace
+
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d) {
+  if (!d)
+    return false;
+
+  std::ifstream stream{path};
+  if (!stream.is_open())
+    return false;
+
+  std::vector<vtype> linear{};
+  vtype entry{};
+  while (true) {
+    stream >> entry;
+    if (stream.eof() || stream.bad())
+      break;
+    linear.push_back(entry);
+  }
+
+  if (stream.bad())
+    return false;
+
+  return fold_square(linear, d);
+}
+
+// Reads the next matrix of a stream holding several, each ended by an empty
+// line or the end of the stream. Returns false at the end of the stream or
+// if the matrix is not square.
+bool read_matrix_frame(std::istream *in, std::vector<std::vector<vtype>> *d) {
+  if (!d)
+    return false;
+
+  std::vector<vtype> linear{};
+  for (std::string line{}; std::getline(*in, line);) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      if (linear.size())
+        break;
+      continue;
+    }
+
+    std::istringstream row{line};
+    for (vtype entry{}; row >> entry;)
+      linear.push_back(entry);
+  }
+
+  return linear.size() && fold_square(linear, d);
+}
+
+// Sorts the elements into the path. If values is set, it receives the
+// sorted element values, one per vertex.
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values) {
+  std::vector<vertex> out{};
+
+  struct sort_info {
+    std::size_t row, col;
+    vtype val;
+  };
+
+  std::vector<sort_info> ordered{};
+  for (std::size_t i = 0; i < m.size(); ++i)
+    for (std::size_t j = 0; j < m[i].size(); ++j)
+      ordered.push_back({i, j, m[i][j]});
+
+  auto ascend = [](const auto &a, const auto &b) { return a.val < b.val; };
+  std::sort(ordered.begin(), ordered.end(), ascend);
+
+  const auto side = std::sqrt(ordered.size());
+  const auto sz = double(side);
+
+  double depth_max{};
+  for (const auto &e : ordered)
+    if (e.val > depth_max)
+      depth_max = e.val;
+
+  for (auto &&e : ordered) {
+    const auto x = e.col / sz - (1.f - e.col / sz) / 2.f;
+    const auto y = e.row / sz - (1.f - e.row / sz) / 2.f;
+    out.push_back(
+        {.position = {x, y, compress ? 0 : e.val / (depth_max / 4.f) - 3.5f},
+         .color = {r, g, b, 1.f}});
+  }
+
+  if (values) {
+    values->resize(ordered.size());
+    for (std::size_t i = 0; i < ordered.size(); ++i)
+      (*values)[i] = ordered[i].val;
+  }
+  return out;
+}
+
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count) {
+  transformation t{};
+  const auto center = glm::vec3(0.f, 0.f, 0.f);
+  const auto eye = glm::vec3(0.f, 0.f, 30.f);
+  const auto up = glm::vec3(0.f, 1.f, 0.f);
+  t.view = glm::lookAt(eye, center, up);
+
+  const auto aspect = float(width) / float(height);
+  const float far = 10 * vertex_count;
+  const auto near = 0.1f;
+  t.projection = glm::perspective(220.f, aspect, near, far);
+  return t;
+}
+
+namespace {
+bool fold_square(const std::vector<vtype> &linear,
+                 std::vector<std::vector<vtype>> *d) {
+  const double root = std::sqrt(linear.size());
+  const std::size_t trunc = root;
+  if (trunc * trunc != linear.size())
+    return false; // matrix is not square
+
+  d->resize(trunc);
+  for (std::size_t i = 0; i < d->size(); ++i)
+    (*d)[i].resize(trunc);
+
+  std::size_t row{}, col{};
+  for (std::size_t i = 0; i < linear.size(); ++i) {
+    (*d)[row][col++] = linear[i];
+    if (col == trunc) {
+      col = 0;
+      ++row;
+    }
+  }
+  return true;
+}
+} // namespace
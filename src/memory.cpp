@@ -0,0 +1,102 @@
+#include "sigil.hpp"
+#include <fstream>
+#include <iomanip>
+#include <logger.hpp>
+#include <map>
+#include <sstream>
+
+void report_memory(context *c);
+
+namespace {
+constexpr double mib = 1 << 20;
+
+std::map<std::string, VkDeviceSize> usage_by_resource(const context *c);
+void add_allocation(const context *c, std::map<std::string, VkDeviceSize> *m,
+                    const char *name, VmaAllocation a);
+} // namespace
+
+// Prints usage against budget for every heap and what each kind of resource
+// costs, then writes VMA's detailed JSON statistics to --memory FILE. The
+// budget is only an estimate of the heap size without VK_EXT_memory_budget.
+void report_memory(context *c) {
+  if (c->memory_file.empty() || !c->allocator.handle)
+    return;
+
+  const VmaAllocator a0 = c->allocator.handle;
+  const VkPhysicalDeviceMemoryProperties *props{};
+  vmaGetMemoryProperties(a0, &props);
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+  vmaGetHeapBudgets(a0, budgets);
+
+  std::ostringstream out{};
+  out << std::fixed << std::setprecision(1);
+  out << std::left << std::setw(10) << "heap" << std::right << std::setw(12)
+      << "usage MiB" << std::setw(12) << "budget MiB" << std::setw(8)
+      << "blocks" << std::setw(8) << "allocs\n";
+  for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+    const auto &b = budgets[i];
+    const bool local =
+        props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    out << std::left << std::setw(10)
+        << (std::to_string(i) + (local ? " local" : " host")) << std::right
+        << std::setw(12) << b.usage / mib << std::setw(12) << b.budget / mib
+        << std::setw(8) << b.statistics.blockCount << std::setw(7)
+        << b.statistics.allocationCount << "\n";
+  }
+
+  out << std::left << std::setw(10) << "resource" << std::right
+      << std::setw(12) << "MiB\n";
+  for (const auto &[name, size] : usage_by_resource(c))
+    out << std::left << std::setw(10) << name << std::right << std::setw(11)
+        << size / mib << "\n";
+
+  // Asked for explicitly, so it does not need --verbose
+  logger l{c->log_level | logger::inf | logger::wrn};
+  l.logi("Device memory", c->memory_budget ? "" : " (estimated budget)",
+         ":\n");
+  l.logs(out.str());
+
+  char *json{};
+  vmaBuildStatsString(a0, &json, VK_TRUE);
+  std::ofstream file{c->memory_file};
+  file << json;
+  vmaFreeStatsString(a0, json);
+  if (!file)
+    l.logw("Failed to write memory statistics: ", c->memory_file, "\n");
+}
+
+namespace {
+// Sizes of the allocations the context owns at the time of the call, the
+// same names are attached to the allocations in the JSON dump
+std::map<std::string, VkDeviceSize> usage_by_resource(const context *c) {
+  std::map<std::string, VkDeviceSize> m{};
+  add_allocation(c, &m, "vertices", c->vertex_buffer.allocation);
+  if (c->sequence)
+    for (const auto &b : c->sequence->buffers)
+      add_allocation(c, &m, "keyframe", b.allocation);
+  for (const auto &i : c->color_images)
+    add_allocation(c, &m, "color", i.allocation);
+
+  for (const auto &f : c->per_frame) {
+    add_allocation(c, &m, "uniforms", f.desc_buffer.allocation);
+    add_allocation(c, &m, "readback", f.readback_buffer.allocation);
+    add_allocation(c, &m, "raster", f.raster_buffer.allocation);
+    add_allocation(c, &m, "overlay", f.hud_buffer.allocation);
+  }
+
+  // Depth and the compute resolve image share these, see graph.cpp
+  for (const auto &b : c->graph.blocks)
+    add_allocation(c, &m, "transient", b.memory.handle);
+  return m;
+}
+
+void add_allocation(const context *c, std::map<std::string, VkDeviceSize> *m,
+                    const char *name, VmaAllocation a) {
+  if (!a)
+    return;
+
+  VmaAllocationInfo info{};
+  vmaGetAllocationInfo(c->allocator.handle, a, &info);
+  (*m)[name] += info.size;
+}
+} // namespace
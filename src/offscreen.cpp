@@ -0,0 +1,163 @@
+#include "sigil.hpp"
+#include <cstdint>
+#include <image.hpp>
+#include <logger.hpp>
+#include <vector>
+
+bool render_offscreen(context *c);
+bool record_offscreen(context *c, uint32_t frame_index, VkBuffer vertices,
+                      draw_range range);
+bool submit_offscreen(context *c, uint32_t frame_index);
+bool read_back(context *c, uint32_t frame_index, std::vector<uint8_t> *pixels);
+void add_compute_passes(context *c, uint32_t frame_index, VkBuffer vertices,
+                        draw_range range, uint32_t target);
+void add_scene_pass(context *c, uint32_t frame_index, uint32_t target,
+                    VkBuffer vertices, draw_range range);
+void begin_queries(context *c, uint32_t frame_index);
+void add_end_queries_pass(context *c, uint32_t frame_index);
+void collect_queries(context *c, uint32_t frame_index);
+draw_range visible_range(const context *c);
+bool execute_graph(context *c, VkCommandBuffer cb);
+
+namespace {
+void add_readback_pass(context *c, uint32_t frame_index, uint32_t target);
+} // namespace
+
+bool render_offscreen(context *c) {
+  const VkFence f = c->per_frame[c->frame_index].presentation_done.handle;
+  const VkDevice dev = c->device.handle;
+  logger l{c->log_level};
+
+  vkWaitForFences(dev, 1, &f, VK_TRUE, UINT64_MAX);
+  vkResetFences(dev, 1, &f);
+
+  if (!record_offscreen(c, c->frame_index, c->vertex_buffer.handle,
+                        visible_range(c)))
+    return false;
+
+  if (!submit_offscreen(c, c->frame_index))
+    return false;
+
+  if (vkWaitForFences(dev, 1, &f, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+    l.loge("Failed to wait for the offscreen frame\n");
+    return false;
+  }
+  collect_queries(c, c->frame_index);
+
+  std::vector<uint8_t> pixels{};
+  if (!read_back(c, c->frame_index, &pixels))
+    return false;
+
+  auto r = image::write(c->output_file, c->window_width, c->window_height,
+                        pixels.data());
+  if (r != common::result::success) {
+    l.loge("Failed to write image: ", c->output_file, "\n");
+    return false;
+  }
+
+  l.logi("Wrote ", c->window_width, "x", c->window_height, " image to ",
+         c->output_file, "\n");
+  return true;
+}
+
+bool record_offscreen(context *c, uint32_t frame_index, VkBuffer vertices,
+                      draw_range range) {
+  logger l{c->log_level};
+  const VkCommandBuffer rb = c->per_frame[frame_index].graphics_buffer;
+  vkResetCommandBuffer(rb, 0);
+
+  VkCommandBufferBeginInfo cb_begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  cb_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(rb, &cb_begin_info) != VK_SUCCESS) {
+    l.loge("Failed to begin command buffer\n");
+    return false;
+  }
+
+  // The previous frame on this image has been waited for, its contents are
+  // overwritten
+  const auto target = c->graph.import_image(
+      "color", c->color_images[frame_index].handle,
+      c->image_views[frame_index].handle, VK_IMAGE_ASPECT_COLOR_BIT, {}, {});
+
+  begin_queries(c, frame_index);
+  if (c->compute)
+    add_compute_passes(c, frame_index, vertices, range, target);
+  else
+    add_scene_pass(c, frame_index, target, vertices, range);
+  add_end_queries_pass(c, frame_index);
+  add_readback_pass(c, frame_index, target);
+
+  if (!execute_graph(c, rb))
+    return false;
+
+  if (vkEndCommandBuffer(rb) != VK_SUCCESS) {
+    l.loge("Failed to end command buffer\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool submit_offscreen(context *c, uint32_t frame_index) {
+  logger l{c->log_level};
+  const VkFence f = c->per_frame[frame_index].presentation_done.handle;
+  const VkCommandBuffer rb = c->per_frame[frame_index].graphics_buffer;
+  VkSubmitInfo sinfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  sinfo.commandBufferCount = 1;
+  sinfo.pCommandBuffers = &rb;
+
+  if (vkQueueSubmit(c->graphics_queue, 1, &sinfo, f) != VK_SUCCESS) {
+    l.loge("Failed to submit commands to graphics queue\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool read_back(context *c, uint32_t frame_index, std::vector<uint8_t> *pixels) {
+  logger l{c->log_level};
+  const auto &rb = c->per_frame[frame_index].readback_buffer;
+  const VkDeviceSize size =
+      VkDeviceSize{c->window_width} * c->window_height * 4;
+  pixels->resize(size);
+
+  if (vmaCopyAllocationToMemory(c->allocator.handle, rb.allocation, 0,
+                                pixels->data(), size) != VK_SUCCESS) {
+    l.loge("Failed to copy pixels from readback buffer\n");
+    return false;
+  }
+
+  return true;
+}
+
+namespace {
+void add_readback_pass(context *c, uint32_t frame_index, uint32_t target) {
+  auto &g = c->graph;
+  graph_use host{.stages = VK_PIPELINE_STAGE_2_HOST_BIT};
+  host.access = VK_ACCESS_2_HOST_READ_BIT;
+  const auto dst = g.import_buffer(
+      "readback", c->per_frame[frame_index].readback_buffer.handle, {}, host);
+
+  graph_use src{.resource = target};
+  src.stages = VK_PIPELINE_STAGE_2_COPY_BIT;
+  src.access = VK_ACCESS_2_TRANSFER_READ_BIT;
+  src.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+  graph_use copy{.resource = dst};
+  copy.stages = VK_PIPELINE_STAGE_2_COPY_BIT;
+  copy.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+  const auto record = [c, target, dst](VkCommandBuffer rb,
+                                       const frame_graph &g) {
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {c->window_width, c->window_height, 1};
+    vkCmdCopyImageToBuffer(rb, g.resources[target].image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           g.resources[dst].buffer, 1, &region);
+  };
+  g.add_pass("readback", {src, copy}, record);
+}
+} // namespace
@@ -0,0 +1,58 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <cmath>
+#include <logger.hpp>
+#include <utility>
+
+namespace ch = std::chrono;
+
+void advance_playback(context *c);
+void pause_playback(context *c);
+void step_playback(context *c, int direction);
+
+namespace {
+// Scrubbing runs this many times faster than playback
+constexpr double scrub_speed{4.};
+} // namespace
+
+// Moves the head of the path growth animation along with the clock. The
+// whole path takes --play milliseconds, however many vertices it has, and
+// only the draw count changes, see visible_range.
+void advance_playback(context *c) {
+  auto &p = c->playback;
+  const auto now = ch::steady_clock::now();
+  const auto last = std::exchange(p.stamp, now);
+  if (!p.active || last == ch::steady_clock::time_point{})
+    return;
+
+  const auto elapsed = ch::duration<double, std::milli>(now - last);
+
+  const double speed = (p.paused ? 0. : 1.) + p.scrub * scrub_speed;
+  const double n = c->vertices.size();
+  p.head = std::clamp(p.head + elapsed.count() * speed * n / c->play, 0., n);
+}
+
+// K pauses and resumes, starting over once the whole path is drawn
+void pause_playback(context *c) {
+  auto &p = c->playback;
+  if (!p.active)
+    return;
+
+  if (p.paused && p.head >= c->vertices.size())
+    p.head = 0;
+  p.paused = !p.paused;
+  logger l{c->log_level};
+  l.logi("Playback ", p.paused ? "paused" : "resumed", " at vertex ",
+         std::size_t(p.head), "\n");
+}
+
+// J and L pause and move the head back and forth by one vertex
+void step_playback(context *c, int direction) {
+  auto &p = c->playback;
+  if (!p.active)
+    return;
+
+  p.paused = true;
+  const double n = c->vertices.size();
+  p.head = std::clamp(std::floor(p.head) + direction, 0., n);
+}
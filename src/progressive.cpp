@@ -0,0 +1,182 @@
+#include "sigil.hpp"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <logger.hpp>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <utility>
+
+bool start_progressive(context *c);
+bool collect_progressive(context *c);
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
+
+namespace {
+// Vertex counts of the successive previews. Each one is cheap to sort and
+// draw no matter how large the matrix is.
+constexpr std::size_t preview_budgets[] = {1 << 12, 1 << 14, 1 << 16};
+
+struct load_options {
+  std::string path{};
+  bool compress{};
+  float red{}, green{}, blue{};
+};
+
+void load(std::stop_token stop, progressive_load *p, load_options o);
+bool sample_matrix(std::stop_token stop, std::ifstream *stream,
+                   std::size_t size, std::size_t side, std::size_t step,
+                   std::vector<std::vector<vtype>> *d);
+void publish(progressive_load *p, std::vector<vertex> &&vertices,
+             std::vector<vtype> &&values, bool done);
+} // namespace
+
+// Starts reading c->matrix_file in the background. A few decimated
+// previews are published first, each denser than the last, and the exact
+// path once the whole file is parsed. collect_progressive picks them up
+// from the render loop.
+bool start_progressive(context *c) {
+  c->loading = std::make_unique<progressive_load>();
+  load_options o{.path = c->matrix_file, .compress = c->compress};
+  o.red = c->red;
+  o.green = c->green;
+  o.blue = c->blue;
+
+  c->loading->loader = std::jthread{load, c->loading.get(), std::move(o)};
+  return true;
+}
+
+// Swaps in the newest published path. The model matrix is kept, so the
+// view does not jump while the path is refined. Returns false if the
+// matrix turned out to be unreadable.
+bool collect_progressive(context *c) {
+  if (!c->loading)
+    return true;
+
+  logger l{c->log_level};
+  auto &p = *c->loading;
+  bool done{false};
+  {
+    std::lock_guard guard{p.lock};
+    if (p.failed) {
+      l.loge("Failed to read matrix from source file\n");
+      return false;
+    }
+
+    if (!p.fresh)
+      return true;
+
+    c->vertices = std::exchange(p.vertices, {});
+    c->values = std::exchange(p.values, {});
+    p.fresh = false;
+    done = p.done;
+  }
+
+  auto t = make_transformation(c->window_width, c->window_height,
+                               c->vertices.size());
+  t.model = c->matrices.model;
+  c->matrices = t;
+  c->update_buffers = true;
+
+  if (done) {
+    l.logi("Loaded ", c->vertices.size(), " vertices\n");
+    c->loading.reset();
+  }
+  return true;
+}
+
+namespace {
+void load(std::stop_token stop, progressive_load *p, load_options o) {
+  std::ifstream stream{o.path};
+  std::string first{};
+  if (!std::getline(stream, first)) {
+    std::lock_guard guard{p->lock};
+    p->failed = true;
+    return;
+  }
+
+  // Rows are laid out one per line, so the first line gives the side of
+  // the matrix and the file size the average length of a row
+  std::istringstream row{first};
+  std::size_t side{};
+  for (vtype entry{}; row >> entry;)
+    ++side;
+
+  stream.seekg(0, std::ios::end);
+  const std::size_t size = stream.tellg();
+
+  for (auto budget : preview_budgets) {
+    const double ratio = double(side) * side / budget;
+    const std::size_t step = std::ceil(std::sqrt(ratio));
+    if (step <= 1)
+      break;
+
+    std::vector<std::vector<vtype>> d{};
+    if (!sample_matrix(stop, &stream, size, side, step, &d))
+      break;
+    std::vector<vtype> values{};
+    auto v = normalize_matrix(d, o.compress, o.red, o.green, o.blue, &values);
+    publish(p, std::move(v), std::move(values), false);
+  }
+
+  std::vector<std::vector<vtype>> d{};
+  if (stop.stop_requested())
+    return;
+
+  if (!read_matrix(o.path, &d)) {
+    std::lock_guard guard{p->lock};
+    p->failed = true;
+    return;
+  }
+
+  std::vector<vtype> values{};
+  auto v = normalize_matrix(d, o.compress, o.red, o.green, o.blue, &values);
+  publish(p, std::move(v), std::move(values), true);
+}
+
+// Reads every step-th row and column into a smaller square matrix. Rows
+// are found by seeking to where they would start if all rows were equally
+// long, so only the sampled rows are parsed. normalize_matrix scales the
+// positions by the side, so the result lines up with the exact path.
+bool sample_matrix(std::stop_token stop, std::ifstream *stream,
+                   std::size_t size, std::size_t side, std::size_t step,
+                   std::vector<std::vector<vtype>> *d) {
+  const std::size_t rows = (side + step - 1) / step;
+  std::string line{};
+
+  for (std::size_t i = 0; i < rows && !stop.stop_requested(); ++i) {
+    stream->clear();
+    stream->seekg(i * step * size / side);
+    if (i)
+      stream->ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (!std::getline(*stream, line))
+      break;
+
+    std::istringstream in{line};
+    std::vector<vtype> sampled{};
+    std::size_t col{};
+    for (vtype entry{}; in >> entry; ++col)
+      if (col % step == 0)
+        sampled.push_back(entry);
+
+    if (sampled.size() == rows)
+      d->push_back(std::move(sampled));
+  }
+
+  return !stop.stop_requested() && d->size();
+}
+
+void publish(progressive_load *p, std::vector<vertex> &&vertices,
+             std::vector<vtype> &&values, bool done) {
+  std::lock_guard guard{p->lock};
+  p->vertices = std::move(vertices);
+  p->values = std::move(values);
+  p->fresh = true;
+  p->done = done;
+}
+} // namespace
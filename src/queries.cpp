@@ -0,0 +1,207 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <logger.hpp>
+#include <numeric>
+
+bool create_queries(context *c);
+void begin_queries(context *c, uint32_t frame_index);
+void add_end_queries_pass(context *c, uint32_t frame_index);
+void collect_queries(context *c, uint32_t frame_index);
+void report_queries(context *c);
+void trace_gpu(context *c, const char *name, uint64_t begin, uint64_t end);
+
+namespace {
+// Frames between two reports while rendering
+constexpr std::size_t report_interval{120};
+
+constexpr const char *statistic_names[] = {
+    "vertex invocations", "clipping invocations", "clipping primitives",
+    "compute invocations"};
+
+VkQueryPipelineStatisticFlags statistic_flags(const context *c);
+uint32_t statistic_count(const context *c);
+logger report_logger(const context *c);
+} // namespace
+
+// Creates a timestamp pool per frame in flight, and a pipeline statistics
+// pool if the device supports them. A queue without valid timestamp bits
+// turns --gpu-timing off with a warning instead of failing, and leaves the
+// pools empty.
+bool create_queries(context *c) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+  const auto &caps = c->device_capabilities;
+  const auto &family =
+      caps.queue_families[c->graphics_queue_family_index].properties;
+
+  if (!family.timestampValidBits ||
+      caps.properties.limits.timestampPeriod <= 0) {
+    if (c->gpu_timing || c->trace)
+      l.logw("The graphics queue does not support timestamps\n");
+    c->gpu_timing = false;
+    return true;
+  }
+
+  c->gpu.timestamp_mask = family.timestampValidBits >= 64
+                              ? ~uint64_t{}
+                              : (uint64_t{1} << family.timestampValidBits) - 1;
+  // The feature is only enabled for --gpu-timing, see create_device
+  c->gpu.statistics = c->gpu_timing && caps.features.pipelineStatisticsQuery;
+
+  for (auto &frame : c->per_frame) {
+    VkQueryPoolCreateInfo info{.sType =
+                                   VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = 2;
+
+    VkQueryPool handle{};
+    auto r = vkCreateQueryPool(dev, &info, nullptr, &handle);
+    if (r != VK_SUCCESS) {
+      l.loge("Failed to create timestamp query pool with code: ", r, "\n");
+      return false;
+    }
+    frame.timestamp_pool = raii::resource<adapter::vk_query_pool>{dev, handle};
+
+    if (!c->gpu.statistics)
+      continue;
+
+    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    info.queryCount = 1;
+    info.pipelineStatistics = statistic_flags(c);
+    r = vkCreateQueryPool(dev, &info, nullptr, &handle);
+    if (r != VK_SUCCESS) {
+      l.loge("Failed to create statistics query pool with code: ", r, "\n");
+      return false;
+    }
+    frame.statistics_pool =
+        raii::resource<adapter::vk_query_pool>{dev, handle};
+  }
+
+  return true;
+}
+
+// Resets the frame's queries and starts measuring. Recorded before the
+// frame graph, right after the command buffer was begun.
+void begin_queries(context *c, uint32_t frame_index) {
+  const auto &frame = c->per_frame[frame_index];
+  if (!frame.timestamp_pool.handle)
+    return;
+
+  const VkCommandBuffer rb = frame.graphics_buffer;
+  vkCmdResetQueryPool(rb, frame.timestamp_pool.handle, 0, 2);
+  if (c->gpu.statistics) {
+    vkCmdResetQueryPool(rb, frame.statistics_pool.handle, 0, 1);
+    vkCmdBeginQuery(rb, frame.statistics_pool.handle, 0, 0);
+  }
+  vkCmdWriteTimestamp(rb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.timestamp_pool.handle, 0);
+}
+
+// Stops measuring after the passes added to the frame graph before it. The
+// pass uses no resources, so it adds no barriers of its own.
+void add_end_queries_pass(context *c, uint32_t frame_index) {
+  auto &frame = c->per_frame[frame_index];
+  if (!frame.timestamp_pool.handle)
+    return;
+
+  const auto end = [c, &frame](VkCommandBuffer rb, const frame_graph &) {
+    vkCmdWriteTimestamp(rb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        frame.timestamp_pool.handle, 1);
+    if (c->gpu.statistics)
+      vkCmdEndQuery(rb, frame.statistics_pool.handle, 0);
+  };
+  c->graph.add_pass("end_queries", {}, end);
+  frame.queries_pending = true;
+}
+
+// Adds the frame's GPU time to the rolling window. Must only be called
+// after the frame's fence has signaled; results are fetched without
+// waiting, so a frame whose queries are not available yet is skipped
+// rather than stalling the caller.
+void collect_queries(context *c, uint32_t frame_index) {
+  auto &frame = c->per_frame[frame_index];
+  if (!frame.queries_pending)
+    return;
+
+  frame.queries_pending = false;
+  const VkDevice dev = c->device.handle;
+  const auto flags =
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+  // Each timestamp is followed by its availability
+  uint64_t stamps[4]{};
+  auto r = vkGetQueryPoolResults(dev, frame.timestamp_pool.handle, 0, 2,
+                                 sizeof(stamps), stamps, 2 * sizeof(uint64_t),
+                                 flags);
+  if (r != VK_SUCCESS || !stamps[1] || !stamps[3])
+    return;
+  trace_gpu(c, "gpu_frame", stamps[0], stamps[2]);
+
+  auto &gpu = c->gpu;
+  const auto ticks = (stamps[2] - stamps[0]) & gpu.timestamp_mask;
+  const auto &limits = c->device_capabilities.properties.limits;
+  const double period = limits.timestampPeriod;
+  gpu.frame_ms[gpu.next] = ticks * period / 1e6;
+  gpu.next = (gpu.next + 1) % gpu.window;
+  gpu.samples = std::min(gpu.samples + 1, gpu.window);
+
+  if (gpu.statistics) {
+    const auto n = statistic_count(c);
+    uint64_t stats[5]{};
+    r = vkGetQueryPoolResults(dev, frame.statistics_pool.handle, 0, 1,
+                              sizeof(stats), stats, sizeof(stats), flags);
+    if (r == VK_SUCCESS && stats[n])
+      std::copy(stats, stats + n, gpu.last_statistics.begin());
+  }
+
+  if (++gpu.since_report >= report_interval)
+    report_queries(c);
+}
+
+// Prints min, average and 99th percentile of the GPU frame times in the
+// window, and the pipeline statistics of the latest frame
+void report_queries(context *c) {
+  auto &gpu = c->gpu;
+  if (!c->gpu_timing || !gpu.samples)
+    return;
+
+  gpu.since_report = 0;
+  std::vector<double> times(gpu.frame_ms.begin(),
+                            gpu.frame_ms.begin() + gpu.samples);
+  std::sort(times.begin(), times.end());
+  const auto avg =
+      std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+  const auto p99 = times[(times.size() - 1) * 99 / 100];
+
+  auto l = report_logger(c);
+  l.logi("GPU frame time over ", times.size(), " frames: min ", times.front(),
+         " ms, avg ", avg, " ms, p99 ", p99, " ms\n");
+
+  if (!gpu.statistics)
+    return;
+
+  for (uint32_t i = 0; i < statistic_count(c); ++i)
+    l.logs("\t", statistic_names[i], ": ", gpu.last_statistics[i], "\n");
+}
+
+namespace {
+// Results are written in bit order, which matches statistic_names
+VkQueryPipelineStatisticFlags statistic_flags(const context *c) {
+  VkQueryPipelineStatisticFlags flags =
+      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT;
+  if (c->compute)
+    flags |= VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+  return flags;
+}
+
+uint32_t statistic_count(const context *c) { return c->compute ? 4 : 3; }
+
+// The report is what --gpu-timing is asked for, so it is printed without
+// --verbose as well, unless stdout carries exported frames
+logger report_logger(const context *c) {
+  const bool to_stdout = c->export_frames && c->output_file == "-";
+  return logger{to_stdout ? c->log_level : c->log_level | logger::inf};
+}
+} // namespace
@@ -0,0 +1,117 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <charconv>
+#include <logger.hpp>
+
+bool parse_range(context *c);
+draw_range visible_range(const context *c);
+void toggle_range(context *c);
+void shift_range(context *c, int direction);
+void scale_range(context *c, int direction);
+
+namespace {
+// Share of the value span the band covers when it is first shown with B
+constexpr vtype initial_bands{10};
+
+void report_range(const context *c);
+} // namespace
+
+// Reads --range LO:HI into c->range
+bool parse_range(context *c) {
+  const auto &s = c->range_text;
+  const auto colon = s.find(':');
+  if (colon == std::string::npos)
+    return false;
+
+  auto &r = c->range;
+  const auto lo = std::from_chars(s.data(), s.data() + colon, r.lo);
+  const auto hi = std::from_chars(s.data() + colon + 1, s.data() + s.size(),
+                                  r.hi);
+  if (lo.ec != std::errc{} || lo.ptr != s.data() + colon ||
+      hi.ec != std::errc{} || hi.ptr != s.data() + s.size() || r.lo > r.hi)
+    return false;
+
+  r.active = true;
+  r.chosen = true;
+  return true;
+}
+
+// The vertices whose values lie in c->range. The path is sorted by value,
+// so that is one contiguous run found with two binary searches and drawn
+// by changing nothing but the first vertex and the vertex count. The
+// whole path is drawn without an active range, and the run ends at the
+// head of an active playback.
+draw_range visible_range(const context *c) {
+  const auto n = c->values.size();
+  const auto m = c->vertices.size();
+  std::size_t end = m;
+  if (c->playback.active)
+    end = std::min(end, std::size_t(c->playback.head));
+  if (!c->range.active || !n || !m)
+    return {0, uint32_t(end)};
+
+  const auto &v = c->values;
+  std::size_t a = std::lower_bound(v.begin(), v.end(), c->range.lo) - v.begin();
+  std::size_t b = std::upper_bound(v.begin(), v.end(), c->range.hi) - v.begin();
+
+  // A decimated path keeps vertex j = floor(j * (n - 1) / (m - 1)) of the
+  // sorted values, see budget.cpp, so the run maps to the kept vertices
+  if (m < n && m > 1) {
+    a = (a * (m - 1) + n - 2) / (n - 1);
+    b = std::min(m, (b * (m - 1) + n - 2) / (n - 1));
+  }
+  b = std::min(b, end);
+  return {uint32_t(a), uint32_t(b - std::min(a, b))};
+}
+
+// B shows a band of values, the lowest tenth of the value span unless a
+// band was given with --range, and shows the whole path again
+void toggle_range(context *c) {
+  auto &r = c->range;
+  if (!r.chosen && c->values.size()) {
+    const auto span = c->values.back() - c->values.front();
+    r.lo = c->values.front();
+    r.hi = r.lo + std::max<vtype>(span / initial_bands, 1);
+    r.chosen = true;
+  }
+
+  r.active = !r.active;
+  report_range(c);
+}
+
+// [ and ] move the band down and up by its own width
+void shift_range(context *c, int direction) {
+  auto &r = c->range;
+  if (!r.active)
+    return;
+
+  const auto width = std::max<vtype>(r.hi - r.lo, 1);
+  r.lo += direction * width;
+  r.hi += direction * width;
+  report_range(c);
+}
+
+// , and . halve and double the band's width around its lower bound
+void scale_range(context *c, int direction) {
+  auto &r = c->range;
+  if (!r.active)
+    return;
+
+  const auto width = r.hi - r.lo;
+  r.hi = r.lo + (direction > 0 ? std::max<vtype>(2 * width, 1) : width / 2);
+  report_range(c);
+}
+
+namespace {
+void report_range(const context *c) {
+  logger l{c->log_level};
+  const auto d = visible_range(c);
+  if (!c->range.active) {
+    l.logi("Drawing the whole path\n");
+    return;
+  }
+
+  l.logi("Drawing values ", c->range.lo, " to ", c->range.hi, ", ", d.count,
+         " vertices\n");
+}
+} // namespace
@@ -1,10 +1,30 @@
 #include "sigil.hpp"
 #include <logger.hpp>
 
+void add_scene_pass(context *c, uint32_t frame_index, uint32_t target,
+                    VkBuffer vertices, draw_range range);
+uint32_t add_depth_transient(context *c);
+void add_hud_pass(context *c, uint32_t frame_index, uint32_t target);
+void add_capture_pass(context *c, uint32_t frame_index, uint32_t image);
+void collect_capture(context *c, uint32_t frame_index);
+void begin_queries(context *c, uint32_t frame_index);
+void add_end_queries_pass(context *c, uint32_t frame_index);
+void collect_queries(context *c, uint32_t frame_index);
+void add_compute_passes(context *c, uint32_t frame_index, VkBuffer vertices,
+                        draw_range range, uint32_t target);
+bool execute_graph(context *c, VkCommandBuffer cb);
+draw_range visible_range(const context *c);
+void record_hud(context *c, uint32_t frame_index);
+void report_startup(context *c, bool first_frame);
+
 namespace {
+// Share of the path over which the playback trail dims behind the head
+constexpr uint32_t fade_share{4};
+
 bool record(context *c, uint32_t frame_index, uint32_t image_index);
 bool submit(context *c, uint32_t frame_index, uint32_t image_index);
 void present(context *c, uint32_t frame_index, uint32_t image_index);
+VkImageAspectFlags depth_aspect(VkFormat format);
 } // namespace
 
 bool render(context *c) {
@@ -18,6 +38,9 @@ bool render(context *c) {
   if (r == VK_TIMEOUT)
     return true;
 
+  collect_capture(c, c->frame_index);
+  collect_queries(c, c->frame_index);
+
   uint32_t image_index{};
   r = vkAcquireNextImageKHR(dev, chain, 0, ia, 0, &image_index);
   if (r != VK_SUCCESS) {
@@ -30,18 +53,135 @@ bool render(context *c) {
 
   vkResetFences(dev, 1, &f);
 
-  if (!record(c, c->frame_index, image_index))
-    return false;
+  {
+    scoped_timer timer{c, frame_phase::record};
+    if (!record(c, c->frame_index, image_index))
+      return false;
+  }
 
-  if (!submit(c, c->frame_index, image_index))
-    return false;
+  {
+    scoped_timer timer{c, frame_phase::submit};
+    if (!submit(c, c->frame_index, image_index))
+      return false;
+  }
 
-  present(c, c->frame_index, image_index);
+  {
+    scoped_timer timer{c, frame_phase::present};
+    present(c, c->frame_index, image_index);
+  }
+  if (++c->frames_rendered == 1)
+    report_startup(c, true);
 
   c->frame_index = (c->frame_index + 1) % c->concurrent_frames;
   return true;
 }
 
+// Draws the path, and the overlay if it is shown, into target with dynamic
+// rendering
+void add_scene_pass(context *c, uint32_t frame_index, uint32_t target,
+                    VkBuffer vertices, draw_range range) {
+  auto &g = c->graph;
+  const auto depth = add_depth_transient(c);
+
+  graph_use color{.resource = target};
+  color.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+  color.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+  color.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  graph_use depth_test{.resource = depth};
+  depth_test.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+  depth_test.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depth_test.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  const auto draw = [c, frame_index, target, depth, vertices,
+                     range](VkCommandBuffer rb, const frame_graph &g) {
+    VkRenderingAttachmentInfo color{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+    color.imageView = g.resources[target].view;
+    color.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color.clearValue.color = {0.f, 0.f, 0.f, 1.f};
+
+    VkRenderingAttachmentInfo depth_attachment{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+    depth_attachment.imageView = g.resources[depth].view;
+    depth_attachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil = {.depth = 1.f, .stencil = 0};
+
+    VkRenderingInfo info{.sType = VK_STRUCTURE_TYPE_RENDERING_INFO};
+    info.renderArea.extent = {c->window_width, c->window_height};
+    info.layerCount = 1;
+    info.colorAttachmentCount = 1;
+    info.pColorAttachments = &color;
+    info.pDepthAttachment = &depth_attachment;
+
+    // Topology may only change within its class, so points have their
+    // own pipeline. Flat drops the depth test and draws in path order.
+    const bool points = c->style == draw_style::points;
+    const bool depth_test = c->style != draw_style::flat;
+    const auto &variant = c->pipelines.at(c->modes);
+    vkCmdBeginRendering(rb, &info);
+    if (range.count) {
+      vkCmdBindPipeline(rb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        points ? variant.points.handle : variant.lines.handle);
+      vkCmdSetPrimitiveTopology(rb, points ? VK_PRIMITIVE_TOPOLOGY_POINT_LIST
+                                           : VK_PRIMITIVE_TOPOLOGY_LINE_STRIP);
+      vkCmdSetDepthTestEnable(rb, depth_test);
+      vkCmdSetDepthWriteEnable(rb, depth_test);
+      vkCmdBindDescriptorSets(rb, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              c->layout.handle, 0, 1,
+                              &c->per_frame[frame_index].descriptor_set, 0, 0);
+      vertex_parameters p{.seed = c->party_seed};
+      p.head = uint32_t(c->playback.head);
+      p.fade = std::max<uint32_t>(c->vertices.size() / fade_share, 1);
+      if (c->sequence)
+        p.t = c->sequence->t;
+      vkCmdPushConstants(rb, c->layout.handle, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                         sizeof(p), &p);
+
+      // Binding 1 is the keyframe interpolated towards, the same buffer
+      // again outside of a sequence
+      VkBuffer streams[] = {vertices, vertices};
+      if (c->sequence)
+        streams[1] = c->sequence->buffers[c->sequence->to].handle;
+      const VkDeviceSize offsets[] = {0, 0};
+      vkCmdBindVertexBuffers(rb, 0, 2, streams, offsets);
+      vkCmdSetViewport(rb, 0, 1, &c->viewport);
+      vkCmdSetScissor(rb, 0, 1, &c->scissor);
+      vkCmdDraw(rb, range.count, 1, range.first, 0);
+    }
+
+    record_hud(c, frame_index);
+    vkCmdEndRendering(rb);
+  };
+
+  g.add_pass("scene", {color, depth_test}, draw);
+}
+
+// Depth is a transient of the graph: cleared at the start of a pass and
+// never stored, it can share memory with other transients
+uint32_t add_depth_transient(context *c) {
+  VkImageCreateInfo info{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  info.imageType = VK_IMAGE_TYPE_2D;
+  info.arrayLayers = 1;
+  info.extent = {c->window_width, c->window_height, 1};
+  info.format = c->depth_format;
+  info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  info.mipLevels = 1;
+  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  info.samples = VK_SAMPLE_COUNT_1_BIT;
+  return c->graph.transient_image("depth", info,
+                                  depth_aspect(c->depth_format));
+}
+
 namespace {
 bool record(context *c, uint32_t frame_index, uint32_t image_index) {
   logger l{c->log_level};
@@ -55,32 +195,33 @@ bool record(context *c, uint32_t frame_index, uint32_t image_index) {
     return false;
   }
 
-  VkRenderPassBeginInfo rp_begin_info{
-      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-  rp_begin_info.framebuffer = c->framebuffers[image_index].handle;
-  rp_begin_info.renderPass = c->render_pass.handle;
-  rp_begin_info.renderArea.extent = {c->window_width, c->window_height};
-  rp_begin_info.renderArea.offset = {0, 0};
-
-  VkClearValue clear_values[2];
-  clear_values[1].depthStencil = {.depth = 1.f, .stencil = 0};
-  clear_values[0].color = {0.f, 0.f, 0.f, 1.f};
-  rp_begin_info.pClearValues = clear_values;
-  rp_begin_info.clearValueCount =
-      sizeof(clear_values) / sizeof(clear_values[0]);
-
-  vkCmdBeginRenderPass(rb, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-  vkCmdBindPipeline(rb, VK_PIPELINE_BIND_POINT_GRAPHICS, c->pipeline.handle);
-  vkCmdBindDescriptorSets(rb, VK_PIPELINE_BIND_POINT_GRAPHICS, c->layout.handle,
-                          0, 1, &c->per_frame[c->frame_index].descriptor_set, 0,
-                          0);
-
-  VkDeviceSize offset{0};
-  vkCmdBindVertexBuffers(rb, 0, 1, &c->vertex_buffer.handle, &offset);
-  vkCmdSetViewport(rb, 0, 1, &c->viewport);
-  vkCmdSetScissor(rb, 0, 1, &c->scissor);
-  vkCmdDraw(rb, c->vertices.size(), 1, 0, 0);
-  vkCmdEndRenderPass(rb);
+  // The image may only be written once the acquire semaphore, waited on
+  // at COLOR_ATTACHMENT_OUTPUT, has signaled
+  auto &g = c->graph;
+  graph_state acquired{};
+  acquired.write_stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+  const graph_use present{.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+  const auto target = g.import_image(
+      "swapchain", c->images[image_index], c->image_views[image_index].handle,
+      VK_IMAGE_ASPECT_COLOR_BIT, acquired, present);
+
+  // Nothing may be loaded yet in progressive mode, see progressive.cpp.
+  // Filtering by value only narrows the draw, the buffer is not touched.
+  const auto range = visible_range(c);
+  const auto &s = c->sequence;
+  const auto vertices =
+      s ? s->buffers[s->from].handle : c->vertex_buffer.handle;
+  begin_queries(c, frame_index);
+  if (c->compute && c->vertices.size()) {
+    add_compute_passes(c, frame_index, vertices, range, target);
+    add_hud_pass(c, frame_index, target);
+  } else
+    add_scene_pass(c, frame_index, target, vertices, range);
+  add_end_queries_pass(c, frame_index);
+  add_capture_pass(c, frame_index, target);
+
+  if (!execute_graph(c, rb))
+    return false;
 
   if (vkEndCommandBuffer(rb) != VK_SUCCESS) {
     l.loge("Failed to end command buffer\n");
@@ -122,4 +263,11 @@ void present(context *c, uint32_t frame_index, uint32_t image_index) {
   pinfo.pImageIndices = &image_index;
   vkQueuePresentKHR(c->presentation_queue, &pinfo);
 }
+
+VkImageAspectFlags depth_aspect(VkFormat format) {
+  if (format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+      format == VK_FORMAT_D24_UNORM_S8_UINT)
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
 } // namespace
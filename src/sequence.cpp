@@ -0,0 +1,252 @@
+#include "sigil.hpp"
+#include <fstream>
+#include <iostream>
+#include <logger.hpp>
+#include <stop_token>
+#include <utility>
+
+namespace ch = std::chrono;
+
+bool start_sequence(context *c);
+bool advance_sequence(context *c);
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+bool read_matrix_frame(std::istream *in, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
+
+namespace {
+// Everything a prefetch needs, so the worker never reads the context
+struct prefetch_options {
+  VmaAllocator allocator{};
+  VmaAllocation target{};
+  std::string path{}; // empty to read the next matrix from stdin
+  std::size_t vertex_count{};
+  bool compress{};
+  float red{}, green{}, blue{};
+};
+
+bool read_list(const std::string &path, std::vector<std::string> *files);
+bool read_keyframe(const std::string &path, const prefetch_options &o,
+                   std::vector<vertex> *vertices, std::vector<vtype> *values);
+bool create_keyframe_buffer(context *c, std::size_t count,
+                            raii::resource<adapter::vma_buffer> *buffer);
+void start_prefetch(context *c);
+void prefetch(std::stop_token stop, keyframe_sequence *s, prefetch_options o,
+              std::vector<vtype> *values);
+} // namespace
+
+// Reads the first two keyframes of --sequence, a file listing one matrix
+// file per line or "-" for matrices on stdin separated by empty lines. The
+// keyframe vertex buffers are created and filled, and the third keyframe
+// is prefetched. The first keyframe also becomes c->vertices, for the
+// vertex count and the camera.
+bool start_sequence(context *c) {
+  logger l{c->log_level};
+  c->sequence = std::make_unique<keyframe_sequence>();
+  auto &s = *c->sequence;
+  if (c->sequence_file != "-" && !read_list(c->sequence_file, &s.files)) {
+    l.loge("Failed to read sequence list: ", c->sequence_file, "\n");
+    return false;
+  }
+
+  if (c->sequence_file != "-" && s.files.size() < 2) {
+    l.loge("A sequence needs at least two matrices\n");
+    return false;
+  }
+
+  prefetch_options o{.compress = c->compress};
+  o.red = c->red;
+  o.green = c->green;
+  o.blue = c->blue;
+
+  std::vector<vertex> first{}, second{};
+  const auto path = [&s](std::size_t i) {
+    return s.files.size() ? s.files[i % s.files.size()] : std::string{};
+  };
+  if (!read_keyframe(path(0), o, &first, &s.values[s.from]) ||
+      !read_keyframe(path(1), o, &second, &s.values[s.to])) {
+    l.loge("A sequence needs at least two readable matrices\n");
+    return false;
+  }
+
+  if (first.size() != second.size()) {
+    l.loge("The matrices of a sequence must have the same size\n");
+    return false;
+  }
+
+  s.vertex_count = first.size();
+  for (auto &b : s.buffers)
+    if (!create_keyframe_buffer(c, s.vertex_count, &b)) {
+      l.loge("Failed to create the keyframe buffers\n");
+      return false;
+    }
+
+  const auto a0 = c->allocator.handle;
+  const auto size = s.vertex_count * sizeof(vertex);
+  if (vmaCopyMemoryToAllocation(a0, first.data(), s.buffers[s.from].allocation,
+                                0, size) != VK_SUCCESS ||
+      vmaCopyMemoryToAllocation(a0, second.data(), s.buffers[s.to].allocation,
+                                0, size) != VK_SUCCESS) {
+    l.loge("Failed to copy keyframes to buffer!\n");
+    return false;
+  }
+
+  c->uploaded_bytes += 2 * size;
+  c->vertices = std::move(first);
+  c->values = std::move(s.values[s.from]);
+  c->matrices = make_transformation(c->window_width, c->window_height,
+                                    c->vertices.size());
+  c->update_buffers = true;
+
+  start_prefetch(c);
+  return true;
+}
+
+// Moves t towards the next keyframe, --keyframe milliseconds apart. Once t
+// reaches 1 the buffers take their next turn if the prefetch is done, and
+// the buffer of the keyframe left behind is refilled as soon as no frame
+// in flight reads it. Until then the sequence holds on the next keyframe,
+// and so it stays at the end of a stream. A list of files starts over
+// after its last keyframe.
+bool advance_sequence(context *c) {
+  if (!c->sequence)
+    return true;
+
+  logger l{c->log_level};
+  auto &s = *c->sequence;
+  // Frame k is submitted once the fence of frame k - concurrent_frames
+  // has signaled, so the frames recorded before the turn are done
+  if (s.waiting &&
+      c->frames_rendered >= s.released + context::concurrent_frames) {
+    s.waiting = false;
+    start_prefetch(c);
+  }
+
+  const auto now = ch::steady_clock::now();
+  const auto last = std::exchange(s.stamp, now);
+  if (last != ch::steady_clock::time_point{}) {
+    const auto elapsed = ch::duration<double, std::milli>(now - last);
+    s.t += elapsed.count() / c->keyframe_ms;
+  }
+  if (s.t < 1.)
+    return true;
+
+  {
+    std::lock_guard guard{s.lock};
+    if (s.failed) {
+      l.loge("Keyframe ", s.keyframe + 2,
+             " is unreadable or differs in size\n");
+      return false;
+    }
+
+    s.t = 1.;
+    if (!s.fresh)
+      return true;
+    s.fresh = false;
+  }
+  s.loader.join();
+
+  const auto done = std::exchange(s.from, s.to);
+  s.to = std::exchange(s.next, done);
+  s.t = 0.;
+  ++s.keyframe;
+  c->values = std::move(s.values[s.from]);
+  l.logi("Keyframe ", s.keyframe, "\n");
+
+  s.released = c->frames_rendered;
+  s.waiting = true;
+  return true;
+}
+
+namespace {
+bool read_list(const std::string &path, std::vector<std::string> *files) {
+  std::ifstream in{path};
+  if (!in)
+    return false;
+
+  for (std::string line{}; std::getline(in, line);) {
+    const auto begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+      continue;
+    const auto end = line.find_last_not_of(" \t\r");
+    files->push_back(line.substr(begin, end + 1 - begin));
+  }
+  return true;
+}
+
+bool read_keyframe(const std::string &path, const prefetch_options &o,
+                   std::vector<vertex> *vertices, std::vector<vtype> *values) {
+  std::vector<std::vector<vtype>> d{};
+  const bool ok =
+      path.size() ? read_matrix(path, &d) : read_matrix_frame(&std::cin, &d);
+  if (!ok)
+    return false;
+
+  *vertices = normalize_matrix(d, o.compress, o.red, o.green, o.blue, values);
+  return true;
+}
+
+// Keyframes are written from a worker thread while the others are drawn,
+// so they live in host visible memory the device reads directly
+bool create_keyframe_buffer(context *c, std::size_t count,
+                            raii::resource<adapter::vma_buffer> *buffer) {
+  const auto a0 = c->allocator.handle;
+  VkBufferCreateInfo vb{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  vb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  vb.size = count * sizeof(vertex);
+  vb.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+  VmaAllocationCreateInfo aci{};
+  aci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+              VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+
+  VkBuffer handle{};
+  VmaAllocation alloc{};
+  if (vmaCreateBuffer(a0, &vb, &aci, &handle, &alloc, 0) != VK_SUCCESS)
+    return false;
+
+  vmaSetAllocationName(a0, alloc, "keyframe");
+  *buffer = raii::resource<adapter::vma_buffer>{a0, alloc, handle};
+  return true;
+}
+
+void start_prefetch(context *c) {
+  auto &s = *c->sequence;
+  prefetch_options o{.allocator = c->allocator.handle};
+  o.target = s.buffers[s.next].allocation;
+  if (s.files.size())
+    o.path = s.files[(s.keyframe + 2) % s.files.size()];
+  o.vertex_count = s.vertex_count;
+  o.compress = c->compress;
+  o.red = c->red;
+  o.green = c->green;
+  o.blue = c->blue;
+
+  s.loader = std::jthread{prefetch, &s, std::move(o), &s.values[s.next]};
+}
+
+// Runs on the loader thread. The target buffer is not drawn from until the
+// keyframe is published, and VMA is internally synchronized.
+void prefetch(std::stop_token stop, keyframe_sequence *s, prefetch_options o,
+              std::vector<vtype> *values) {
+  std::vector<vertex> vertices{};
+  bool ok = read_keyframe(o.path, o, &vertices, values);
+  // Only a stream can run out of keyframes, a list starts over
+  const bool ended = !ok && !o.path.size();
+  ok = ok && vertices.size() == o.vertex_count &&
+       vmaCopyMemoryToAllocation(o.allocator, vertices.data(), o.target, 0,
+                                 vertices.size() * sizeof(vertex)) ==
+           VK_SUCCESS;
+  if (stop.stop_requested())
+    return;
+
+  std::lock_guard guard{s->lock};
+  s->fresh = ok;
+  s->ended = ended;
+  s->failed = !ok && !ended;
+}
+} // namespace
@@ -1,15 +1,28 @@
 #pragma once
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <channel.hpp>
+#include <functional>
 #include <glfw_adapter.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <resource.hpp>
 #include <specs.hpp>
 #include <string>
+#include <thread>
+#include <vector>
 #include <vk_adapter.hpp>
 
+using vtype = int;
+
 struct vertex {
   glm::vec3 position{};
   glm::vec4 color{};
@@ -36,6 +49,315 @@ struct transformation {
 	glm::mat4 projection{1.f};
 };
 
+struct job {
+  std::string matrix_file{};
+  std::string output_file{};
+  bool compress{false};
+  float red{0.f}, green{0.f}, blue{0.f};
+};
+
+// A frame copied into a readback buffer, waiting to be encoded. The
+// encoder reads the buffer in place and clears encoding once it is done.
+struct capture_job {
+  std::string output_file{};
+  VmaAllocator allocator{};
+  VmaAllocation pixels{};
+  uint32_t width{}, height{};
+  bool bgra{false};
+  std::atomic<bool> *encoding{};
+};
+
+struct capture_queue {
+  channel<capture_job> jobs{8};
+  std::jthread encoder{};
+
+  ~capture_queue() { jobs.close(); }
+};
+
+// A timed initialization step, see timing.cpp
+struct phase_time {
+  std::string name{};
+  double start{}, duration{}; // milliseconds since launch
+  bool worker{false};         // ran on a worker thread
+};
+
+// Paths published by the progressive loader, see progressive.cpp
+struct progressive_load {
+  std::mutex lock{};
+  std::vector<vertex> vertices{};
+  std::vector<vtype> values{};
+  bool fresh{false}, done{false}, failed{false};
+  std::jthread loader{};
+};
+
+// Where the vertex buffer ended up given the memory budget, see budget.cpp
+enum class vertex_placement : uint8_t { device, staged, host, decimated };
+
+// How the path is drawn, cycled with S at runtime. Points use their own
+// pipeline, the rest is dynamic state, see add_scene_pass.
+enum class draw_style : uint8_t { lines, points, flat, count };
+
+inline constexpr const char *draw_style_names[] = {"lines", "points", "flat"};
+
+// Run of the path's vertices drawn, see visible_range
+struct draw_range {
+  uint32_t first{}, count{};
+};
+
+// Band of element values to draw, set with --range or B at runtime
+struct value_range {
+  bool active{false};
+  bool chosen{false}; // lo and hi hold a band, from --range or B
+  vtype lo{}, hi{};
+};
+
+// Features of shader.vert selected with specialization constants, so each
+// combination compiles into a variant without runtime branches
+enum shader_mode : uint32_t {
+  party_colors = 1 << 0,
+  playback_fade = 1 << 1,
+  keyframes = 1 << 2
+};
+inline constexpr uint32_t shader_mode_count{3};
+
+// Keyframes of --sequence, see sequence.cpp. Three vertex buffers take
+// turns: the two keyframes drawn and the next one, prefetched and uploaded
+// on a worker thread while the current pair is interpolated. The buffer a
+// keyframe leaves is refilled once the frames in flight no longer read it.
+struct keyframe_sequence {
+  std::vector<std::string> files{}; // empty when reading stdin
+  std::size_t keyframe{};           // of the current keyframe
+  std::size_t vertex_count{};
+  std::size_t from{0}, to{1}, next{2};
+  std::array<raii::resource<adapter::vma_buffer>, 3> buffers{};
+  std::array<std::vector<vtype>, 3> values{};
+  double t{};
+  std::chrono::steady_clock::time_point stamp{};
+  std::size_t released{}; // frames_rendered when buffers[next] was left
+  bool waiting{false};    // for the frames reading buffers[next]
+
+  std::mutex lock{};
+  bool fresh{false}, failed{false}, ended{false};
+  std::jthread loader{};
+};
+
+// Mirrors the push constant block of shader.vert
+struct vertex_parameters {
+  uint32_t seed{}; // party_colors
+  uint32_t head{}; // playback_fade, vertices drawn so far
+  uint32_t fade{}; // playback_fade, vertices behind the head until dimmed
+  float t{};       // keyframes, from the current to the next keyframe
+};
+
+// Path growth animation of --play, see playback.cpp
+struct playback_state {
+  bool active{false}, paused{false};
+  int scrub{}; // -1 or 1 while Page Down or Page Up is held
+  double head{};
+  std::chrono::steady_clock::time_point stamp{};
+};
+
+// Pipelines of one shader mode combination, one per topology class
+struct pipeline_variant {
+  raii::resource<adapter::vk_pipeline> lines{};
+  raii::resource<adapter::vk_pipeline> points{};
+};
+
+// Rolling window of GPU frame times, see queries.cpp
+struct gpu_times {
+  static constexpr std::size_t window{256};
+  std::array<double, window> frame_ms{}; // ring buffer
+  std::size_t samples{}, next{}, since_report{};
+  uint64_t timestamp_mask{};
+  bool statistics{false};
+  std::array<uint64_t, 4> last_statistics{};
+};
+
+// Parts of an interactive frame measured with --stats and --trace
+enum class frame_phase : uint8_t {
+  poll,
+  update,
+  wait_idle,
+  upload,
+  record,
+  submit,
+  present,
+  sleep,
+  count
+};
+
+inline constexpr const char *frame_phase_names[] = {
+    "poll",   "update", "wait_idle", "upload",
+    "record", "submit", "present",   "sleep"};
+
+// Fixed histograms of phase durations, see stats.cpp. Buckets are a
+// quarter octave wide, so adding a sample is a few integer operations.
+struct frame_stats {
+  static constexpr std::size_t phases{std::size_t(frame_phase::count)};
+  static constexpr std::size_t buckets{96};
+  std::array<std::array<uint32_t, buckets>, phases> histograms{};
+  std::size_t frames{};
+
+  static std::size_t bucket(std::chrono::nanoseconds d) {
+    const uint64_t us = std::max<int64_t>(d.count() / 1000, 0);
+    if (us < 4)
+      return us;
+    const std::size_t bits = std::bit_width(us);
+    return std::min(4 * (bits - 2) + ((us >> (bits - 3)) & 3), buckets - 1);
+  }
+
+  void add(frame_phase p, std::chrono::nanoseconds d) {
+    ++histograms[std::size_t(p)][bucket(d)];
+  }
+};
+
+// Events recorded with --trace, see trace.cpp
+struct trace_event {
+  const char *name{};          // a string literal, written out at exit
+  char type{'X'};              // 'X' for spans, 'C' for counters
+  bool gpu{false};             // on the GPU track rather than the thread's
+  int64_t start{}, duration{}; // nanoseconds since launch
+  double value{};
+};
+
+// The events of one thread. Only the owning thread appends, so recording
+// takes no lock; the buffers are read once all threads are done.
+struct trace_buffer {
+  uint32_t tid{};
+  const char *thread_name{};
+  std::vector<trace_event> events{};
+};
+
+struct trace_log {
+  using time_point = std::chrono::steady_clock::time_point;
+  time_point origin{};
+  std::mutex lock{}; // taken once per thread, to register its buffer
+  std::vector<std::unique_ptr<trace_buffer>> buffers{};
+
+  // One-shot mapping of GPU timestamps onto the CPU clock
+  bool calibrated{false};
+  uint64_t gpu_origin{}, timestamp_mask{};
+  int64_t cpu_origin{};
+  double timestamp_period{};
+
+  trace_buffer *local();
+  void name_thread(const char *name);
+  void span(const char *name, time_point start, time_point end);
+  void counter(const char *name, double value);
+};
+
+// Records a span from construction until it goes out of scope, if tracing
+struct trace_scope {
+  trace_scope(trace_log *t, const char *n)
+      : trace{t}, name{n}, start{t ? std::chrono::steady_clock::now()
+                                   : trace_log::time_point{}} {}
+  trace_scope(const trace_scope &) = delete;
+  trace_scope &operator=(const trace_scope &) = delete;
+  ~trace_scope() {
+    if (trace)
+      trace->span(name, start, std::chrono::steady_clock::now());
+  }
+
+  trace_log *trace{};
+  const char *name{};
+  trace_log::time_point start{};
+};
+
+// A character of the overlay, see hud.cpp
+struct hud_glyph {
+  float x{}, y{};  // top left corner in pixels
+  uint32_t code{}; // index into the font of hud.frag
+};
+
+struct hud_state {
+  bool visible{false};
+  std::vector<hud_glyph> glyphs{}; // text of the last refresh
+  std::chrono::steady_clock::time_point refreshed{};
+  std::size_t frames{}, uploaded{}; // counters at the last refresh
+  double cpu_ms{};                  // CPU time of the latest frame
+};
+
+// Synchronization state of a frame graph resource, see graph.cpp
+struct graph_state {
+  VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  VkPipelineStageFlags2 write_stages{}; // of the last write, or of the
+  VkAccessFlags2 write_access{};        // semaphore wait before the graph
+  VkPipelineStageFlags2 read_stages{};  // reads since the last write
+  VkPipelineStageFlags2 visible_stages{}; // the last write is visible to
+  VkAccessFlags2 visible_access{};
+};
+
+// How a pass uses a resource. A pass uses each resource at most once.
+struct graph_use {
+  uint32_t resource{};
+  VkPipelineStageFlags2 stages{};
+  VkAccessFlags2 access{};
+  VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED}; // ignored for buffers
+};
+
+struct frame_graph;
+struct graph_pass {
+  const char *name{};
+  std::vector<graph_use> uses{};
+  std::function<void(VkCommandBuffer, const frame_graph &)> record{};
+};
+
+struct graph_resource {
+  const char *name{};
+  VkImage image{};
+  VkImageView view{};
+  VkImageAspectFlags aspect{};
+  VkBuffer buffer{};
+  graph_state state{}; // before the first pass, then as recorded
+  graph_use after{};   // what follows the graph, e.g. presentation
+  int32_t transient{-1};
+};
+
+// An image whose memory belongs to the graph. Transients whose passes do
+// not overlap within a frame share a block.
+struct graph_transient {
+  const char *name{};
+  VkImageCreateInfo info{};
+  VkImageAspectFlags aspect{};
+  raii::resource<adapter::vk_image> image{};
+  raii::resource<adapter::vk_image_view> view{};
+  VkMemoryRequirements requirements{};
+  int32_t block{-1};
+  uint32_t first{}, last{}; // passes of the current frame
+  bool used{false};
+};
+
+struct graph_block {
+  raii::resource<adapter::vma_memory> memory{};
+  VkDeviceSize size{};
+  uint32_t type{};
+  graph_state state{}; // of the last use of the memory, across frames
+};
+
+// Passes of a frame and the resources they use. Barriers, layout
+// transitions and transient memory are derived when the graph is
+// executed, see graph.cpp.
+struct frame_graph {
+  using record_t = std::function<void(VkCommandBuffer, const frame_graph &)>;
+  std::vector<graph_resource> resources{};
+  std::vector<graph_pass> passes{};
+  std::vector<graph_transient> transients{};
+  std::vector<graph_block> blocks{};
+  // Transients moved to another block, with the execution they left at
+  std::vector<std::pair<std::size_t, graph_transient>> retired{};
+  std::size_t executions{};
+
+  uint32_t import_image(const char *name, VkImage image, VkImageView view,
+                        VkImageAspectFlags aspect, const graph_state &before,
+                        const graph_use &after);
+  uint32_t import_buffer(const char *name, VkBuffer buffer,
+                         const graph_state &before, const graph_use &after);
+  uint32_t transient_image(const char *name, const VkImageCreateInfo &info,
+                           VkImageAspectFlags aspect);
+  void add_pass(const char *name, std::vector<graph_use> uses,
+                record_t record);
+};
+
 struct frame_objects {
   VkCommandBuffer presentation_buffer{};
   VkCommandBuffer graphics_buffer{};
@@ -44,6 +366,24 @@ struct frame_objects {
   raii::resource<adapter::vk_fence> presentation_done{};
   VkDescriptorSet descriptor_set{};
   raii::resource<adapter::vma_buffer> desc_buffer{};
+  raii::resource<adapter::vma_buffer> readback_buffer{};
+  // Set from the capture pass until the encoder is done with the buffer
+  std::string capture_file{};
+  bool capture_queued{false};
+  std::atomic<bool> capture_encoding{false};
+
+  // Compute rasterizer, see compute.cpp
+  VkDescriptorSet compute_set{};
+  raii::resource<adapter::vma_buffer> raster_buffer{};
+
+  // GPU timing, see queries.cpp
+  raii::resource<adapter::vk_query_pool> timestamp_pool{};
+  raii::resource<adapter::vk_query_pool> statistics_pool{};
+  bool queries_pending{false};
+
+  // Overlay, see hud.cpp
+  raii::resource<adapter::vma_buffer> hud_buffer{};
+  void *hud_mapped{};
 };
 
 struct context {
@@ -63,10 +403,41 @@ struct context {
       shift_r{0.1f},   // rotation
       shift_s{0.1},    // scale
       red{0.f}, green{0.f}, blue{0.f};
-  bool debug{false}, help{false}, compress{false};
+  bool debug{false}, help{false}, compress{false}, headless{false},
+      software{false}, compute{false}, density{false}, progressive{false},
+      gpu_timing{false}, stats{false}, memory_budget{false};
   std::string matrix_file{};
+  std::string output_file{};
+  std::string batch{};
+  std::string manifest{};
+  std::vector<job> jobs{};
   std::size_t log_level{};
   std::size_t party{};
+  std::size_t play{};
+  std::string sequence_file{};
+  std::size_t keyframe_ms{1000};
+  std::size_t capture_frames{}, capture_count{};
+  std::size_t export_frames{};
+  bool capture_supported{false};
+  std::unique_ptr<progressive_load> loading{};
+  std::chrono::steady_clock::time_point launch{};
+  std::vector<phase_time> phases{};
+  std::string timings_file{};
+  std::size_t frames_rendered{};
+  gpu_times gpu{};
+  std::unique_ptr<frame_stats> profile{};
+  std::string trace_file{};
+  std::unique_ptr<trace_log> trace{};
+  std::string memory_file{};
+  std::string range_text{};
+  value_range range{};
+  vertex_placement placement{vertex_placement::device};
+  draw_style style{draw_style::lines};
+  uint32_t modes{};      // shader_mode bits of the variant drawn with
+  uint32_t party_seed{}; // changes every --party milliseconds
+  playback_state playback{};
+  std::size_t uploaded_bytes{};
+  hud_state hud{};
 
   VkApplicationInfo app_info{};
   VkViewport viewport{};
@@ -91,25 +462,68 @@ struct context {
   raii::resource<adapter::vk_swapchain> swapchain{};
   VkSurfaceFormatKHR surface_format{};
   std::vector<VkImage> images{};
+  std::vector<raii::resource<adapter::vma_image>> color_images{};
   std::vector<raii::resource<adapter::vk_image_view>> image_views{};
-  std::vector<raii::resource<adapter::vma_image>> depth_images{};
-  std::vector<raii::resource<adapter::vk_image_view>> depth_views{};
   VkFormat depth_format{};
-  std::vector<raii::resource<adapter::vk_framebuffer>> framebuffers{};
 
-  raii::resource<adapter::vk_render_pass> render_pass{};
   raii::resource<adapter::vk_command_pool> presentation_command_pool{};
   raii::resource<adapter::vk_command_pool> graphics_command_pool{};
 	raii::resource<adapter::vk_descriptor_pool> desc_pool{};
 	raii::resource<adapter::vk_descriptor_set_layout> desc_layout{};
   std::array<frame_objects, concurrent_frames> per_frame{};
+  raii::resource<adapter::vk_pipeline_cache> pipeline_cache{};
+  std::size_t pipeline_cache_size{};
   raii::resource<adapter::vk_pipeline_layout> layout{};
-  raii::resource<adapter::vk_pipeline> pipeline{};
+  std::map<uint32_t, pipeline_variant> pipelines{}; // by shader_mode bits
+  raii::resource<adapter::vk_descriptor_pool> compute_desc_pool{};
+  raii::resource<adapter::vk_descriptor_set_layout> compute_desc_layout{};
+  raii::resource<adapter::vk_pipeline_layout> compute_layout{};
+  raii::resource<adapter::vk_pipeline> raster_pipeline{};
+  raii::resource<adapter::vk_pipeline> resolve_pipeline{};
+  raii::resource<adapter::vk_pipeline_layout> hud_layout{};
+  raii::resource<adapter::vk_pipeline> hud_pipeline{};
 
   VkBufferCreateInfo vertex_buffer_create_info{};
   raii::resource<adapter::vma_buffer> vertex_buffer{};
   std::vector<vertex> vertices{};
+  std::vector<vtype> values{}; // ascending, one per vertex before decimation
   transformation matrices{};
   bool update_buffers{false};
   std::size_t frame_index{};
+
+  std::unique_ptr<keyframe_sequence> sequence{};
+  // After per_frame, so the encoder stops reading the readback buffers
+  // before they are destroyed
+  std::unique_ptr<capture_queue> capture{};
+
+  // Last, so transient memory is released before the allocator, see
+  // graph.cpp
+  frame_graph graph{};
+};
+
+// Adds the time until it goes out of scope to a frame phase, for --stats
+// and --trace. Does nothing when neither is on.
+struct scoped_timer {
+  scoped_timer(const context *c, frame_phase p)
+      : stats{c->profile.get()}, trace{c->trace.get()}, phase{p} {
+    if (stats || trace)
+      start = std::chrono::steady_clock::now();
+  }
+  scoped_timer(const scoped_timer &) = delete;
+  scoped_timer &operator=(const scoped_timer &) = delete;
+  ~scoped_timer() {
+    if (!stats && !trace)
+      return;
+
+    const auto end = std::chrono::steady_clock::now();
+    if (stats)
+      stats->add(phase, end - start);
+    if (trace)
+      trace->span(frame_phase_names[std::size_t(phase)], start, end);
+  }
+
+  frame_stats *stats{};
+  trace_log *trace{};
+  frame_phase phase{};
+  std::chrono::steady_clock::time_point start{};
 };
@@ -0,0 +1,406 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <cmath>
+#include <image.hpp>
+#include <logger.hpp>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIGIL_X86 1
+#endif
+
+bool render_software(context *c);
+bool read_matrix(const std::string &path, std::vector<std::vector<vtype>> *d);
+std::vector<vertex> normalize_matrix(const std::vector<std::vector<vtype>> &m,
+                                     bool compress, float r, float g, float b,
+                                     std::vector<vtype> *values);
+transformation make_transformation(uint32_t width, uint32_t height,
+                                   std::size_t vertex_count);
+
+namespace {
+// A line segment in framebuffer coordinates, z is the depth in [0, 1]
+struct segment {
+  glm::vec3 p0{}, p1{};
+  glm::vec4 c0{}, c1{};
+  bool visible{false};
+};
+
+struct target {
+  uint32_t width{}, height{};
+  std::vector<uint8_t> color{};
+  std::vector<float> depth{};
+};
+
+// Segments reaching each row band, band k's are indices[offsets[k]] up to
+// indices[offsets[k + 1]], in path order
+struct band_bins {
+  std::vector<std::size_t> offsets{};
+  std::vector<uint32_t> indices{};
+};
+
+using transform_fn = void (*)(const glm::mat4 &, const vertex *, std::size_t,
+                              glm::vec4 *);
+
+transform_fn select_transform(const char **name);
+void transform_scalar(const glm::mat4 &m, const vertex *v, std::size_t n,
+                      glm::vec4 *out);
+#ifdef SIGIL_X86
+void transform_sse(const glm::mat4 &m, const vertex *v, std::size_t n,
+                   glm::vec4 *out);
+void transform_avx2(const glm::mat4 &m, const vertex *v, std::size_t n,
+                    glm::vec4 *out);
+#endif
+
+bool render_image(const std::vector<vertex> &vertices,
+                  const transformation &matrices, transform_fn transform,
+                  std::size_t threads, target *t);
+segment make_segment(const glm::vec4 &a, const glm::vec4 &b,
+                     const glm::vec4 &ca, const glm::vec4 &cb, float width,
+                     float height);
+bool clip_axis(float p, float d, float lo, float hi, float *t0, float *t1);
+bool band_span(const segment &s, uint32_t height, std::size_t bands,
+               std::size_t *first, std::size_t *last);
+band_bins bin_segments(const std::vector<segment> &segments, uint32_t height,
+                       std::size_t bands, std::size_t threads);
+void rasterize(const std::vector<segment> &segments, const uint32_t *begin,
+               const uint32_t *end, uint32_t y_begin, uint32_t y_end,
+               target *t);
+
+// Splits [0, n) into one contiguous range per thread and runs f on each
+template <typename F> void parallel_for(std::size_t n, std::size_t threads,
+                                        F &&f) {
+  threads = std::max<std::size_t>(1, std::min(threads, n));
+  std::vector<std::jthread> workers{};
+  for (std::size_t i = 0; i < threads; ++i)
+    workers.emplace_back(f, n * i / threads, n * (i + 1) / threads);
+}
+} // namespace
+
+// Renders the sigil without Vulkan. The vertices go through the same
+// model, view and projection matrices as in the vertex shader, using
+// AVX2 or SSE when the CPU has it, and the line strip is rasterized with
+// a depth tested DDA. The image is split into horizontal bands, one per
+// thread, so no two threads ever touch the same pixel, and the segments
+// are binned by band first, so each thread only clips the segments that
+// reach its own band.
+bool render_software(context *c) {
+  const std::size_t threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  logger l{c->log_level};
+
+  const char *kernel{};
+  const auto transform = select_transform(&kernel);
+  l.logi("Software renderer: ", kernel, " transform, ", threads,
+         " threads\n");
+
+  std::vector<job> jobs{c->jobs};
+  if (!jobs.size()) {
+    job j{.matrix_file = c->matrix_file, .output_file = c->output_file};
+    jobs.push_back(std::move(j));
+  }
+
+  target t{.width = c->window_width, .height = c->window_height};
+  std::size_t failed{};
+
+  for (const auto &j : jobs) {
+    std::vector<vertex> vertices{};
+    transformation matrices{};
+
+    if (c->jobs.size()) {
+      std::vector<std::vector<vtype>> data{};
+      if (!read_matrix(j.matrix_file, &data)) {
+        l.loge("Failed to read matrix from source file: ", j.matrix_file,
+               "\n");
+        ++failed;
+        continue;
+      }
+
+      vertices =
+          normalize_matrix(data, j.compress, j.red, j.green, j.blue, nullptr);
+      matrices = make_transformation(t.width, t.height, vertices.size());
+    }
+
+    const auto &v = c->jobs.size() ? vertices : c->vertices;
+    const auto &m = c->jobs.size() ? matrices : c->matrices;
+    if (!render_image(v, m, transform, threads, &t)) {
+      ++failed;
+      continue;
+    }
+
+    auto r = image::write(j.output_file, t.width, t.height, t.color.data());
+    if (r != common::result::success) {
+      l.loge("Failed to write image: ", j.output_file, "\n");
+      ++failed;
+      continue;
+    }
+    l.logi("Wrote ", t.width, "x", t.height, " image to ", j.output_file,
+           "\n");
+  }
+
+  return !failed;
+}
+
+namespace {
+transform_fn select_transform(const char **name) {
+#ifdef SIGIL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    *name = "AVX2";
+    return transform_avx2;
+  }
+
+  *name = "SSE";
+  return transform_sse;
+#else
+  *name = "scalar";
+  return transform_scalar;
+#endif
+}
+
+// out[i] = m * vec4(v[i].position, 1), i.e. the clip space position
+void transform_scalar(const glm::mat4 &m, const vertex *v, std::size_t n,
+                      glm::vec4 *out) {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = m * glm::vec4(v[i].position, 1.f);
+}
+
+#ifdef SIGIL_X86
+void transform_sse(const glm::mat4 &m, const vertex *v, std::size_t n,
+                   glm::vec4 *out) {
+  const __m128 c0 = _mm_loadu_ps(&m[0][0]);
+  const __m128 c1 = _mm_loadu_ps(&m[1][0]);
+  const __m128 c2 = _mm_loadu_ps(&m[2][0]);
+  const __m128 c3 = _mm_loadu_ps(&m[3][0]);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto &p = v[i].position;
+    __m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p.x)));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(p.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p.z)));
+    _mm_storeu_ps(&out[i].x, r);
+  }
+}
+
+// Two vertices per iteration, one in each 128 bit lane
+__attribute__((target("avx2,fma"))) void
+transform_avx2(const glm::mat4 &m, const vertex *v, std::size_t n,
+               glm::vec4 *out) {
+  // No lambdas here, they would not inherit the target attribute
+  const auto *cols = reinterpret_cast<const __m128 *>(&m[0][0]);
+  const __m256 c0 = _mm256_broadcast_ps(cols);
+  const __m256 c1 = _mm256_broadcast_ps(cols + 1);
+  const __m256 c2 = _mm256_broadcast_ps(cols + 2);
+  const __m256 c3 = _mm256_broadcast_ps(cols + 3);
+
+  std::size_t i{};
+  for (; i + 2 <= n; i += 2) {
+    const auto &a = v[i].position, &b = v[i + 1].position;
+    const __m256 x = _mm256_setr_ps(a.x, a.x, a.x, a.x, b.x, b.x, b.x, b.x);
+    const __m256 y = _mm256_setr_ps(a.y, a.y, a.y, a.y, b.y, b.y, b.y, b.y);
+    const __m256 z = _mm256_setr_ps(a.z, a.z, a.z, a.z, b.z, b.z, b.z, b.z);
+    __m256 r = _mm256_fmadd_ps(c0, x, c3);
+    r = _mm256_fmadd_ps(c1, y, r);
+    r = _mm256_fmadd_ps(c2, z, r);
+    _mm256_storeu_ps(&out[i].x, r);
+  }
+
+  transform_sse(m, v + i, n - i, out + i);
+}
+#endif
+
+bool render_image(const std::vector<vertex> &vertices,
+                  const transformation &matrices, transform_fn transform,
+                  std::size_t threads, target *t) {
+  const std::size_t pixels = std::size_t{t->width} * t->height;
+  t->color.assign(pixels * 4, 0);
+  t->depth.assign(pixels, 1.f);
+  for (std::size_t i = 3; i < t->color.size(); i += 4)
+    t->color[i] = 255;
+
+  if (vertices.size() < 2)
+    return true;
+
+  const auto mvp = matrices.projection * matrices.view * matrices.model;
+  std::vector<glm::vec4> clip(vertices.size());
+  parallel_for(vertices.size(), threads, [&](std::size_t b, std::size_t e) {
+    transform(mvp, vertices.data() + b, e - b, clip.data() + b);
+  });
+
+  const float w = float(t->width), h = float(t->height);
+  std::vector<segment> segments(vertices.size() - 1);
+  parallel_for(segments.size(), threads, [&](std::size_t b, std::size_t e) {
+    for (auto i = b; i < e; ++i)
+      segments[i] = make_segment(clip[i], clip[i + 1], vertices[i].color,
+                                 vertices[i + 1].color, w, h);
+  });
+
+  const auto bands = std::max<std::size_t>(1, std::min<std::size_t>(
+                                                 threads, t->height));
+  const auto bins = bin_segments(segments, t->height, bands, threads);
+  parallel_for(bands, bands, [&](std::size_t b, std::size_t e) {
+    for (auto k = b; k < e; ++k)
+      rasterize(segments, bins.indices.data() + bins.offsets[k],
+                bins.indices.data() + bins.offsets[k + 1],
+                t->height * k / bands, t->height * (k + 1) / bands, t);
+  });
+  return true;
+}
+
+// Clips the segment against w > 0 and maps it to framebuffer coordinates.
+// The pipeline enables depth clamping, so there is no near or far plane
+// clipping, only clamping of the depth.
+segment make_segment(const glm::vec4 &a, const glm::vec4 &b,
+                     const glm::vec4 &ca, const glm::vec4 &cb, float width,
+                     float height) {
+  constexpr float epsilon{1e-5f};
+  segment s{};
+  if (a.w < epsilon && b.w < epsilon)
+    return s;
+
+  auto pa = a, pb = b;
+  s.c0 = ca;
+  s.c1 = cb;
+  if (pa.w < epsilon || pb.w < epsilon) {
+    const float t = (epsilon - a.w) / (b.w - a.w);
+    const auto p = a + t * (b - a);
+    const auto c = ca + t * (cb - ca);
+    if (pa.w < epsilon) {
+      pa = p;
+      s.c0 = c;
+    } else {
+      pb = p;
+      s.c1 = c;
+    }
+  }
+
+  const auto screen = [width, height](const glm::vec4 &p) {
+    const auto ndc = glm::vec3(p) / p.w;
+    return glm::vec3((ndc.x + 1.f) * .5f * width, (ndc.y + 1.f) * .5f * height,
+                     std::clamp(ndc.z, 0.f, 1.f));
+  };
+
+  s.p0 = screen(pa);
+  s.p1 = screen(pb);
+  s.visible = std::isfinite(s.p0.x + s.p0.y + s.p1.x + s.p1.y);
+  return s;
+}
+
+// Liang-Barsky: narrows [*t0, *t1] to the part where p + t * d >= lo and
+// p + t * d <= hi
+bool clip_axis(float p, float d, float lo, float hi, float *t0, float *t1) {
+  if (d == 0.f)
+    return p >= lo && p <= hi;
+
+  float a = (lo - p) / d, b = (hi - p) / d;
+  if (a > b)
+    std::swap(a, b);
+  *t0 = std::max(*t0, a);
+  *t1 = std::min(*t1, b);
+  return *t0 <= *t1;
+}
+
+// First and last band a segment may reach, with band k covering rows
+// height * k / bands up to height * (k + 1) / bands. Like the clipping in
+// rasterize, a segment ending on the first row of a band also reaches the
+// band above it.
+bool band_span(const segment &s, uint32_t height, std::size_t bands,
+               std::size_t *first, std::size_t *last) {
+  const float h = float(height);
+  const float y0 = std::min(s.p0.y, s.p1.y), y1 = std::max(s.p0.y, s.p1.y);
+  if (!s.visible || !height || y1 < 0.f || y0 > h)
+    return false;
+
+  const auto band = [height, bands, h](float y) {
+    const std::size_t row = std::clamp(y, 0.f, h - 1.f);
+    return ((row + 1) * bands - 1) / height;
+  };
+  *first = band(std::ceil(y0) - 1.f);
+  *last = band(y1);
+  return true;
+}
+
+// Counts the segments per band and chunk of the path, then scatters their
+// indices at the offsets of an exclusive prefix sum over the counts. Both
+// passes run over the same chunks in parallel, and each band's list keeps
+// the chunks in path order, so depth ties resolve as without binning.
+band_bins bin_segments(const std::vector<segment> &segments, uint32_t height,
+                       std::size_t bands, std::size_t threads) {
+  const auto n = segments.size();
+  const auto chunks = std::max<std::size_t>(1, std::min(threads, n));
+  std::vector<std::size_t> counts(chunks * bands);
+
+  const auto each = [&](auto &&f) {
+    parallel_for(chunks, chunks, [&](std::size_t b, std::size_t e) {
+      for (auto k = b; k < e; ++k)
+        for (auto i = n * k / chunks; i < n * (k + 1) / chunks; ++i) {
+          std::size_t first{}, last{};
+          if (band_span(segments[i], height, bands, &first, &last))
+            for (auto j = first; j <= last; ++j)
+              f(counts[k * bands + j], i);
+        }
+    });
+  };
+
+  each([](std::size_t &count, std::size_t) { ++count; });
+
+  band_bins bins{.offsets = std::vector<std::size_t>(bands + 1)};
+  std::size_t total{};
+  for (std::size_t j = 0; j < bands; ++j) {
+    bins.offsets[j] = total;
+    for (std::size_t k = 0; k < chunks; ++k) {
+      const auto count = counts[k * bands + j];
+      counts[k * bands + j] = total;
+      total += count;
+    }
+  }
+  bins.offsets[bands] = total;
+
+  bins.indices.resize(total);
+  each([&bins](std::size_t &next, std::size_t i) {
+    bins.indices[next++] = uint32_t(i);
+  });
+  return bins;
+}
+
+void rasterize(const std::vector<segment> &segments, const uint32_t *begin,
+               const uint32_t *end, uint32_t y_begin, uint32_t y_end,
+               target *t) {
+  const float x_max = float(t->width), y_lo = float(y_begin),
+              y_hi = float(y_end);
+
+  for (auto it = begin; it != end; ++it) {
+    const auto &s = segments[*it];
+
+    const auto d = s.p1 - s.p0;
+    float t0{0.f}, t1{1.f};
+    if (!clip_axis(s.p0.x, d.x, 0.f, x_max, &t0, &t1) ||
+        !clip_axis(s.p0.y, d.y, y_lo, y_hi, &t0, &t1))
+      continue;
+
+    // One sample per pixel along the major axis, as in Bresenham
+    const float length = std::max(std::abs(d.x), std::abs(d.y)) * (t1 - t0);
+    const auto steps = std::max<std::size_t>(1, std::ceil(length));
+    const float dt = (t1 - t0) / float(steps);
+
+    for (std::size_t k = 0; k <= steps; ++k) {
+      const float u = t0 + dt * float(k);
+      const auto p = s.p0 + u * d;
+      const auto x = uint32_t(std::min(p.x, x_max - 1.f));
+      const auto y = std::clamp(uint32_t(p.y), y_begin, y_end - 1);
+
+      const std::size_t i = std::size_t{y} * t->width + x;
+      if (p.z >= t->depth[i])
+        continue;
+
+      t->depth[i] = p.z;
+      const auto c = glm::clamp(s.c0 + u * (s.c1 - s.c0), 0.f, 1.f);
+      auto *out = &t->color[i * 4];
+      out[0] = uint8_t(c.r * 255.f + .5f);
+      out[1] = uint8_t(c.g * 255.f + .5f);
+      out[2] = uint8_t(c.b * 255.f + .5f);
+      out[3] = uint8_t(c.a * 255.f + .5f);
+    }
+  }
+}
+} // namespace
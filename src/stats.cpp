@@ -0,0 +1,82 @@
+#include "sigil.hpp"
+#include <iomanip>
+#include <logger.hpp>
+#include <sstream>
+
+void report_stats(context *c);
+
+namespace {
+// A phase longer than one frame at 60 Hz shows up as a hitch. Only buckets
+// that start past it are counted, so a stall is certainly one.
+constexpr double stall_ms{1000.0 / 60.0};
+
+static_assert(std::size(frame_phase_names) == frame_stats::phases);
+
+double bucket_end(std::size_t bucket);
+double percentile(const std::array<uint32_t, frame_stats::buckets> &h,
+                  uint64_t total, double p);
+} // namespace
+
+// Prints the number of samples, p50/p95/p99 and the number of stalls of
+// every phase since startup. Percentiles are bucket upper bounds, so they
+// are accurate to a quarter octave.
+void report_stats(context *c) {
+  if (!c->profile)
+    return;
+
+  const auto &s = *c->profile;
+  std::ostringstream out{};
+  out << std::fixed << std::setprecision(3);
+  out << std::left << std::setw(10) << "phase" << std::right << std::setw(10)
+      << "samples" << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms"
+      << std::setw(10) << "p99 ms" << std::setw(8) << "stalls\n";
+
+  for (std::size_t p = 0; p < frame_stats::phases; ++p) {
+    const auto &h = s.histograms[p];
+    uint64_t total{}, stalls{};
+    for (std::size_t b = 0; b < frame_stats::buckets; ++b) {
+      total += h[b];
+      if (b && bucket_end(b - 1) >= stall_ms)
+        stalls += h[b];
+    }
+    if (!total)
+      continue;
+
+    out << std::left << std::setw(10) << frame_phase_names[p] << std::right
+        << std::setw(10) << total << std::setw(10)
+        << percentile(h, total, 0.5) << std::setw(10)
+        << percentile(h, total, 0.95) << std::setw(10)
+        << percentile(h, total, 0.99) << std::setw(7) << stalls << "\n";
+  }
+
+  // Asked for explicitly, so it does not need --verbose
+  logger l{c->log_level | logger::inf};
+  l.logi("Frame phases after ", s.frames, " frames:\n");
+  l.logs(out.str());
+}
+
+namespace {
+// Upper end of a bucket in milliseconds, the inverse of
+// frame_stats::bucket
+double bucket_end(std::size_t bucket) {
+  const auto next = bucket + 1;
+  if (next < 4)
+    return next / 1000.0;
+
+  const auto bits = next / 4 + 2;
+  const uint64_t us = (4 + next % 4) << (bits - 3);
+  return us / 1000.0;
+}
+
+double percentile(const std::array<uint32_t, frame_stats::buckets> &h,
+                  uint64_t total, double p) {
+  const auto rank = uint64_t(p * (total - 1)) + 1;
+  uint64_t seen{};
+  for (std::size_t b = 0; b < frame_stats::buckets; ++b) {
+    seen += h[b];
+    if (seen >= rank)
+      return bucket_end(b);
+  }
+  return bucket_end(frame_stats::buckets - 1);
+}
+} // namespace
@@ -0,0 +1,113 @@
+#include "sigil.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <logger.hpp>
+#include <sstream>
+
+namespace ch = std::chrono;
+
+void add_phase(const context *c, std::vector<phase_time> *phases,
+               const char *name, ch::steady_clock::time_point start,
+               bool worker);
+void report_startup(context *c, bool first_frame);
+
+namespace {
+double since_launch(const context *c, ch::steady_clock::time_point t);
+void print_table(const context *c);
+bool write_json(const context *c);
+std::string escape(const std::string &s);
+} // namespace
+
+// Records a step that began at start and ends now. Worker threads pass
+// their own vector, which initialize merges once they are joined.
+void add_phase(const context *c, std::vector<phase_time> *phases,
+               const char *name, ch::steady_clock::time_point start,
+               bool worker) {
+  const auto now = ch::steady_clock::now();
+  phase_time p{.name = name, .start = since_launch(c, start)};
+  p.duration = since_launch(c, now) - p.start;
+  p.worker = worker;
+  phases->push_back(std::move(p));
+
+  if (c->trace)
+    c->trace->span(name, start, now);
+}
+
+// Prints the startup phases with --verbose and writes them to
+// --timings. With first_frame, the time from launch until now is added as
+// the time to first frame, so call it right after the first frame went out.
+void report_startup(context *c, bool first_frame) {
+  logger l{c->log_level};
+  if (first_frame)
+    add_phase(c, &c->phases, "first_frame", c->launch, false);
+
+  // Worker phases are appended when their thread is joined, so put them
+  // back in the order they ran in
+  std::stable_sort(
+      c->phases.begin(), c->phases.end(),
+      [](const auto &a, const auto &b) { return a.start < b.start; });
+  print_table(c);
+  if (c->timings_file.size() && !write_json(c))
+    l.logw("Failed to write startup timings: ", c->timings_file, "\n");
+}
+
+namespace {
+double since_launch(const context *c, ch::steady_clock::time_point t) {
+  return ch::duration<double, std::milli>(t - c->launch).count();
+}
+
+void print_table(const context *c) {
+  logger l{c->log_level};
+  std::size_t width{5};
+  for (const auto &p : c->phases)
+    width = std::max(width, p.name.size());
+
+  std::ostringstream out{};
+  out << std::fixed << std::setprecision(3);
+  out << std::left << std::setw(width) << "phase" << std::right
+      << std::setw(12) << "start ms" << std::setw(12) << "took ms"
+      << "  thread\n";
+  for (const auto &p : c->phases)
+    out << std::left << std::setw(width) << p.name << std::right
+        << std::setw(12) << p.start << std::setw(12) << p.duration << "  "
+        << (p.worker ? "worker" : "main") << "\n";
+
+  l.logs("Startup timings:\n", out.str());
+}
+
+bool write_json(const context *c) {
+  std::ofstream out{c->timings_file};
+  const auto &props = c->device_capabilities.properties;
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\n  \"device\": \"" << escape(props.deviceName) << "\",\n";
+  out << "  \"driver_version\": " << props.driverVersion << ",\n";
+  out << "  \"width\": " << c->window_width << ",\n";
+  out << "  \"height\": " << c->window_height << ",\n";
+  out << "  \"vertices\": " << c->vertices.size() << ",\n";
+  out << "  \"phases\": [";
+
+  for (std::size_t i = 0; i < c->phases.size(); ++i) {
+    const auto &p = c->phases[i];
+    out << (i ? ",\n" : "\n") << "    {\"name\": \"" << escape(p.name)
+        << "\", \"start_ms\": " << p.start
+        << ", \"duration_ms\": " << p.duration << ", \"thread\": \""
+        << (p.worker ? "worker" : "main") << "\"}";
+  }
+
+  out << "\n  ]\n}\n";
+  return bool(out);
+}
+
+std::string escape(const std::string &s) {
+  std::string out{};
+  for (const char ch : s) {
+    if (ch == '"' || ch == '\\')
+      out += '\\';
+    if (static_cast<unsigned char>(ch) >= 0x20)
+      out += ch;
+  }
+  return out;
+}
+} // namespace
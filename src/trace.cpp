@@ -0,0 +1,207 @@
+#include "sigil.hpp"
+#include <fstream>
+#include <iomanip>
+#include <logger.hpp>
+
+namespace ch = std::chrono;
+
+bool create_trace(context *c);
+bool calibrate_trace(context *c);
+void trace_gpu(context *c, const char *name, uint64_t begin, uint64_t end);
+void write_trace(context *c);
+
+namespace {
+// Track of the spans reconstructed from timestamp queries
+constexpr uint32_t gpu_tid{0};
+
+int64_t since(trace_log::time_point origin, trace_log::time_point t);
+void write_event(std::ostream *out, const trace_event &e, uint32_t tid);
+void write_thread_name(std::ostream *out, uint32_t tid, const char *name);
+} // namespace
+
+// Starts recording with the calling thread as the main thread. Spans are
+// relative to c->launch.
+bool create_trace(context *c) {
+  c->trace = std::make_unique<trace_log>();
+  c->trace->origin = c->launch;
+  c->trace->name_thread("main");
+  return true;
+}
+
+// Maps GPU timestamps onto the CPU clock once, by writing a single
+// timestamp and taking the midpoint of the CPU time around its submission.
+// Good enough to line up a run; the two clocks are not re-synchronized, so
+// they may drift apart over very long traces.
+bool calibrate_trace(context *c) {
+  logger l{c->log_level};
+  const VkDevice dev = c->device.handle;
+  const VkQueryPool pool = c->per_frame[0].timestamp_pool.handle;
+  if (!c->trace || !pool)
+    return true;
+
+  VkCommandBufferAllocateInfo cbinfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cbinfo.commandPool = c->graphics_command_pool.handle;
+  cbinfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cbinfo.commandBufferCount = 1;
+
+  VkCommandBuffer cb{};
+  if (vkAllocateCommandBuffers(dev, &cbinfo, &cb) != VK_SUCCESS) {
+    l.loge("Failed to allocate the calibration command buffer\n");
+    return false;
+  }
+
+  VkCommandBufferBeginInfo begin{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cb, &begin);
+  vkCmdResetQueryPool(cb, pool, 0, 2);
+  vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+  vkEndCommandBuffer(cb);
+
+  VkFenceCreateInfo finfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkFence handle{};
+  if (vkCreateFence(dev, &finfo, nullptr, &handle) != VK_SUCCESS) {
+    vkFreeCommandBuffers(dev, cbinfo.commandPool, 1, &cb);
+    l.loge("Failed to create the calibration fence\n");
+    return false;
+  }
+  raii::resource<adapter::vk_fence> fence{dev, handle};
+
+  VkSubmitInfo sinfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  sinfo.commandBufferCount = 1;
+  sinfo.pCommandBuffers = &cb;
+
+  const auto before = ch::steady_clock::now();
+  auto r = vkQueueSubmit(c->graphics_queue, 1, &sinfo, handle);
+  if (r == VK_SUCCESS)
+    r = vkWaitForFences(dev, 1, &handle, VK_TRUE, UINT64_MAX);
+  const auto after = ch::steady_clock::now();
+
+  uint64_t ticks{};
+  if (r == VK_SUCCESS)
+    r = vkGetQueryPoolResults(dev, pool, 0, 1, sizeof(ticks), &ticks,
+                              sizeof(ticks),
+                              VK_QUERY_RESULT_64_BIT |
+                                  VK_QUERY_RESULT_WAIT_BIT);
+  vkFreeCommandBuffers(dev, cbinfo.commandPool, 1, &cb);
+  if (r != VK_SUCCESS) {
+    l.loge("Failed to calibrate GPU timestamps with code: ", r, "\n");
+    return false;
+  }
+
+  auto &t = *c->trace;
+  t.gpu_origin = ticks;
+  t.cpu_origin = (since(t.origin, before) + since(t.origin, after)) / 2;
+  t.timestamp_mask = c->gpu.timestamp_mask;
+  t.timestamp_period =
+      c->device_capabilities.properties.limits.timestampPeriod;
+  t.calibrated = true;
+  return true;
+}
+
+// Adds a span on the GPU track from two raw timestamps
+void trace_gpu(context *c, const char *name, uint64_t begin, uint64_t end) {
+  if (!c->trace || !c->trace->calibrated)
+    return;
+
+  auto &t = *c->trace;
+  const auto to_ns = [&t](uint64_t ticks) {
+    const auto delta = (ticks - t.gpu_origin) & t.timestamp_mask;
+    return t.cpu_origin + int64_t(delta * t.timestamp_period);
+  };
+
+  trace_event e{.name = name, .gpu = true, .start = to_ns(begin)};
+  e.duration = to_ns(end) - e.start;
+  t.local()->events.push_back(e);
+}
+
+// Writes the trace event JSON that chrome://tracing and Perfetto load. Must
+// only be called once every thread that recorded events has finished.
+void write_trace(context *c) {
+  if (!c->trace)
+    return;
+
+  logger l{c->log_level};
+  std::ofstream out{c->trace_file};
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+  std::lock_guard guard{c->trace->lock};
+  write_thread_name(&out, gpu_tid, "gpu");
+  std::size_t count{};
+  for (const auto &b : c->trace->buffers) {
+    write_thread_name(&out, b->tid, b->thread_name);
+    for (const auto &e : b->events)
+      write_event(&out, e, e.gpu ? gpu_tid : b->tid);
+    count += b->events.size();
+  }
+
+  out << "\n]}\n";
+  if (!out) {
+    l.logw("Failed to write trace: ", c->trace_file, "\n");
+    return;
+  }
+  l.logi("Wrote ", count, " trace events to ", c->trace_file, "\n");
+}
+
+// The buffer is looked up once per thread and cached, so recording an
+// event is a vector append
+trace_buffer *trace_log::local() {
+  thread_local trace_log *owner{};
+  thread_local trace_buffer *buffer{};
+  if (owner == this)
+    return buffer;
+
+  std::lock_guard guard{lock};
+  buffers.push_back(std::make_unique<trace_buffer>());
+  buffer = buffers.back().get();
+  buffer->tid = buffers.size();
+  buffer->events.reserve(1 << 14);
+  owner = this;
+  return buffer;
+}
+
+// Names the calling thread, unless it already has a name
+void trace_log::name_thread(const char *name) {
+  auto b = local();
+  if (!b->thread_name)
+    b->thread_name = name;
+}
+
+void trace_log::span(const char *name, time_point start, time_point end) {
+  trace_event e{.name = name, .start = since(origin, start)};
+  e.duration = since(origin, end) - e.start;
+  local()->events.push_back(e);
+}
+
+void trace_log::counter(const char *name, double value) {
+  trace_event e{.name = name, .type = 'C'};
+  e.start = since(origin, ch::steady_clock::now());
+  e.value = value;
+  local()->events.push_back(e);
+}
+
+namespace {
+int64_t since(trace_log::time_point origin, trace_log::time_point t) {
+  return ch::duration_cast<ch::nanoseconds>(t - origin).count();
+}
+
+// Trace timestamps are in microseconds
+void write_event(std::ostream *out, const trace_event &e, uint32_t tid) {
+  *out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"" << e.type
+       << "\", \"pid\": 1, \"tid\": " << tid << ", \"ts\": " << e.start / 1e3;
+  if (e.type == 'C')
+    *out << ", \"args\": {\"value\": " << e.value << "}}";
+  else
+    *out << ", \"dur\": " << e.duration / 1e3 << "}";
+}
+
+void write_thread_name(std::ostream *out, uint32_t tid, const char *name) {
+  if (tid != gpu_tid)
+    *out << ",\n";
+  *out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+       << tid << ", \"args\": {\"name\": \"" << (name ? name : "worker")
+       << "\"}}";
+}
+} // namespace
@@ -1,30 +1,62 @@
 #include "sigil.hpp"
+#include <algorithm>
 #include <chrono>
 #include <logger.hpp>
 #include <random>
 
 namespace ch = std::chrono;
 bool update(context *c);
+bool collect_progressive(context *c);
+bool advance_sequence(context *c);
+void toggle_hud(context *c);
+void toggle_range(context *c);
+void shift_range(context *c, int direction);
+void scale_range(context *c, int direction);
+void advance_playback(context *c);
+void pause_playback(context *c);
+void step_playback(context *c, int direction);
+bool create_vertex_buffer(context *c, std::vector<vertex> *vertices,
+                          raii::resource<adapter::vma_buffer> *buffer);
+bool fill_vertex_buffer(context *c, const std::vector<vertex> &vertices,
+                        const raii::resource<adapter::vma_buffer> &buffer);
 
 namespace {
 bool update_buffers(context *c);
 void update_input(context *c);
-void party(std::vector<vertex> &vertices, std::size_t t);
+void party(context *c);
 } // namespace
 
 bool update(context *c) {
   logger l{c->log_level};
-  if (c->update_buffers || c->party) {
-    vkDeviceWaitIdle(c->device.handle);
-    update_buffers(c);
-    if (vmaCopyMemoryToAllocation(c->allocator.handle, c->vertices.data(),
-                                  c->vertex_buffer.allocation, 0,
-                                  c->vertex_buffer_create_info.size) !=
-        VK_SUCCESS) {
+  scoped_timer timer{c, frame_phase::update};
+  if (!collect_progressive(c) || !advance_sequence(c))
+    return false;
+
+  // The compute rasterizer reads colors from the vertex buffer, the
+  // graphics pipelines make them up in the vertex shader
+  if (c->update_buffers || (c->compute && c->modes & party_colors)) {
+    {
+      scoped_timer wait{c, frame_phase::wait_idle};
+      vkDeviceWaitIdle(c->device.handle);
+    }
+    scoped_timer upload{c, frame_phase::upload};
+    if (!update_buffers(c))
+      return false;
+    // Progressive previews can be smaller than the buffer. Keyframes have
+    // buffers of their own, see sequence.cpp.
+    const auto size = c->sequence ? 0 : c->vertices.size() * sizeof(vertex);
+    if (size && !fill_vertex_buffer(c, c->vertices, c->vertex_buffer)) {
       l.loge("Failed to copy vertices to buffer!\n");
       return false;
     }
 
+    const auto ubos = c->concurrent_frames * sizeof(transformation);
+    c->uploaded_bytes += size + ubos;
+    if (c->trace) {
+      c->trace->counter("vertices", c->vertices.size());
+      c->trace->counter("uploaded_bytes", size + ubos);
+    }
+
     for (std::size_t i = 0; i < c->concurrent_frames; ++i) {
       if (vmaCopyMemoryToAllocation(c->allocator.handle, &c->matrices,
                                     c->per_frame[i].desc_buffer.allocation, 0,
@@ -50,10 +82,11 @@ bool update(context *c) {
     c->update_buffers = false;
   }
 
-  update_input(c);
+  if (c->window.handle)
+    update_input(c);
 
-  if (c->party)
-    party(c->vertices, c->party);
+  if (c->modes & party_colors)
+    party(c);
 
   return true;
 }
@@ -64,17 +97,24 @@ inline std::size_t make_random(std::size_t begin, std::size_t end) {
   return begin + rng() % end;
 }
 
-void party(std::vector<vertex> &vertices, std::size_t t) {
+// Picks new colors every --party milliseconds: a new seed for the
+// party_colors shader mode, and new vertex colors for the compute rasterizer
+void party(context *c) {
   static auto stamp = decltype(ch::steady_clock::now()){};
   const auto now = ch::steady_clock::now();
+  const ch::milliseconds t{c->party};
 
-  if (ch::duration_cast<ch::milliseconds>(now - stamp) > ch::milliseconds{t} ||
+  if (ch::duration_cast<ch::milliseconds>(now - stamp) > t ||
       stamp == decltype(ch::steady_clock::now()){})
     stamp = now;
   else
     return;
 
-  for (auto &v : vertices) {
+  ++c->party_seed;
+  if (!c->compute)
+    return;
+
+  for (auto &v : c->vertices) {
     double r = make_random(0, 256) / 255.0;
     double g = make_random(0, 256) / 255.0;
     double b = make_random(0, 256) / 255.0;
@@ -141,12 +181,95 @@ bool update_rotate(context *c) {
   return false;
 }
 
+// F12 captures the next presented frame, see capture.cpp
+void update_capture(context *c) {
+  static bool was_pressed{false};
+  const bool pressed =
+      glfwGetKey(c->window.handle, GLFW_KEY_F12) == GLFW_PRESS;
+
+  if (pressed && !was_pressed)
+    c->capture_frames = std::max<std::size_t>(c->capture_frames, 1);
+  was_pressed = pressed;
+}
+
+// H shows and hides the overlay, see hud.cpp
+void update_hud(context *c) {
+  static bool was_pressed{false};
+  const bool pressed = glfwGetKey(c->window.handle, GLFW_KEY_H) == GLFW_PRESS;
+
+  if (pressed && !was_pressed)
+    toggle_hud(c);
+  was_pressed = pressed;
+}
+
+// S cycles through the draw styles. Every style's pipeline was built at
+// startup, so the switch shows in the next frame without compiling.
+void update_style(context *c) {
+  static bool was_pressed{false};
+  const bool pressed = glfwGetKey(c->window.handle, GLFW_KEY_S) == GLFW_PRESS;
+
+  constexpr auto styles = std::size_t(draw_style::count);
+  if (pressed && !was_pressed)
+    c->style = draw_style((std::size_t(c->style) + 1) % styles);
+  was_pressed = pressed;
+}
+
+// B filters the path to a band of values, [ and ] move the band and , and .
+// narrow and widen it. Only the draw range changes, nothing is uploaded.
+void update_range(context *c) {
+  constexpr int keys[] = {GLFW_KEY_B, GLFW_KEY_LEFT_BRACKET,
+                          GLFW_KEY_RIGHT_BRACKET, GLFW_KEY_COMMA,
+                          GLFW_KEY_PERIOD};
+  static bool was_pressed[std::size(keys)]{};
+
+  for (std::size_t i = 0; i < std::size(keys); ++i) {
+    const bool pressed = glfwGetKey(c->window.handle, keys[i]) == GLFW_PRESS;
+    if (pressed && !was_pressed[i]) {
+      if (i == 0)
+        toggle_range(c);
+      else if (i < 3)
+        shift_range(c, i == 1 ? -1 : 1);
+      else
+        scale_range(c, i == 3 ? -1 : 1);
+    }
+    was_pressed[i] = pressed;
+  }
+}
+
+// K pauses and resumes playback, J and L step one vertex back and forth
+// and Page Down and Page Up scrub while held
+void update_playback(context *c) {
+  constexpr int keys[] = {GLFW_KEY_K, GLFW_KEY_J, GLFW_KEY_L};
+  static bool was_pressed[std::size(keys)]{};
+  const auto w = c->window.handle;
+
+  for (std::size_t i = 0; i < std::size(keys); ++i) {
+    const bool pressed = glfwGetKey(w, keys[i]) == GLFW_PRESS;
+    if (pressed && !was_pressed[i]) {
+      if (i == 0)
+        pause_playback(c);
+      else
+        step_playback(c, i == 1 ? -1 : 1);
+    }
+    was_pressed[i] = pressed;
+  }
+
+  c->playback.scrub = (glfwGetKey(w, GLFW_KEY_PAGE_UP) == GLFW_PRESS) -
+                      (glfwGetKey(w, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS);
+  advance_playback(c);
+}
+
 void update_input(context *c) {
   const auto x_axis = glm::vec3(1.f, 0.f, 0.f);
   const auto y_axis = glm::vec3(0.f, 1.f, 0.f);
   const auto z_axis = glm::vec3(0.f, 0.f, 1.f);
   const auto w = c->window.handle;
   auto &mat = c->matrices.model;
+  update_capture(c);
+  update_hud(c);
+  update_style(c);
+  update_range(c);
+  update_playback(c);
 
   if (!update_rotate(c) && (glfwGetKey(w, GLFW_KEY_MINUS) == GLFW_PRESS)) {
     const auto v = 1.f - c->shift_s;
@@ -189,37 +312,23 @@ void update_input(context *c) {
   }
 }
 
+// Grows the vertex buffer when the path no longer fits. Called after the
+// device went idle, so the old buffer can be released. A path too large
+// for the memory budget may be decimated, see budget.cpp.
 bool update_buffers(context *c) {
   auto &vb = c->vertex_buffer_create_info;
-  auto a0 = c->allocator.handle;
-  logger l{c->log_level};
 
   const auto element_size = sizeof(decltype(c->vertices)::value_type);
   const auto current_size = c->vertices.size() * element_size;
 
-  if (current_size <= vb.size)
+  if (current_size <= vb.size || c->sequence)
     return true;
 
-  vb.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  vb.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  vb.size = current_size;
-  vb.usage =
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-
-  VmaAllocationCreateInfo aci{};
-  VkBuffer vbuf{}, ibuf{};
-  VmaAllocation valloc{}, ialloc{};
-  VmaAllocationInfo vai{}, iai{};
-
-  aci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-  aci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-  if (vmaCreateBuffer(a0, &vb, &aci, &vbuf, &valloc, &vai) != VK_SUCCESS) {
-    l.loge("Failed to create vk buffer using VMA\n");
+  if (!create_vertex_buffer(c, &c->vertices, &c->vertex_buffer))
     return false;
-  }
 
-  c->vertex_buffer = raii::resource<adapter::vma_buffer>{a0, valloc, vbuf};
+  vb.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  vb.size = c->vertices.size() * element_size;
   return true;
 }
 } // namespace